@@ -0,0 +1,58 @@
+/**
+ * @file bitboard.h
+ *
+ * @brief Bitboard interface, used for fast reachability and distance checks
+ */
+
+#ifndef _QUOR_BITBOARD_H_
+#define _QUOR_BITBOARD_H_
+
+#include "board.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/** @enum Implementations of the flood fill kernel */
+enum bitboard_impl_t {
+	BITBOARD_AUTO, 		/**< Best implementation supported by the processor */
+	BITBOARD_SCALAR, 	/**< Portable 64 bits implementation */
+	BITBOARD_SSE2, 		/**< 128 bits implementation */
+	BITBOARD_AVX2 		/**< 256 bits implementation */
+};
+
+/** @struct Struct representing the edges of a board as bitsets of vertices */
+struct bitboard_t {
+	size_t num_vertices;            /**< Number of vertices of the board */
+	size_t width;                   /**< Number of vertices on a side of the board */
+	size_t words;                   /**< Number of words of a plane, a multiple of 4 */
+	size_t stride;                  /**< Distance in words between two planes, padding included */
+	uint64_t* planes;               /**< Memory holding all the planes */
+	uint64_t* open[MAX_DIRECTION];  /**< open[d] bit v set means there is an edge from v in direction d */
+	uint64_t* goal[2];              /**< goal[p] bit v set means that v is on the arrival line of p */
+	uint64_t* work[2];              /**< Planes used to hold the frontier during searches */
+};
+
+/** @brief Allocate a bitboard for a square board of size m */
+struct bitboard_t* bitboard_alloc(size_t m);
+
+/** @brief Free the memory allocated for a bitboard */
+void bitboard_free(struct bitboard_t* bb);
+
+/** @brief Copy the edges and the arrival lines of a graph into a bitboard */
+void bitboard_load(struct bitboard_t* bb, const struct graph_t* graph);
+
+/** @brief Close the two edges of a wall in a bitboard */
+void bitboard_close_wall(struct bitboard_t* bb, const struct edge_t e[2]);
+
+/** @brief Open again the two edges of a wall closed by bitboard_close_wall() */
+void bitboard_open_wall(struct bitboard_t* bb, const struct edge_t e[2]);
+
+/** @brief Get the shortest distance between a position and the arrival line of a player */
+size_t bitboard_distance(struct bitboard_t* bb, size_t pos, enum color_t color);
+
+/** @brief Check if a player can reach its arrival line from a position */
+bool bitboard_can_reach(struct bitboard_t* bb, size_t pos, enum color_t color);
+
+/** @brief Choose the flood fill implementation, return false if it is not supported */
+bool bitboard_select(enum bitboard_impl_t impl);
+
+#endif // _QUOR_BITBOARD_H_
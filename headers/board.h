@@ -10,6 +10,9 @@
 #include "opt.h"
 #include "graph.h"
 #include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
 
 
 #define IMPOSSIBLE_DISTANCE 500000
@@ -25,6 +28,61 @@ enum orientation_t {
 	HORIZONTAL, VERTICAL, ERROR_ORIENTATION = -1
 };
 
+/** @enum Flags stored for each vertex in `graph->cells` */
+enum cell_flag_t {
+	CLOSED_NORTH = 1 << NORTH, 	/**< No edge to the north */
+	CLOSED_SOUTH = 1 << SOUTH, 	/**< No edge to the south */
+	CLOSED_WEST = 1 << WEST, 	/**< No edge to the west */
+	CLOSED_EAST = 1 << EAST, 	/**< No edge to the east */
+	WALL_HEAD_EAST = 1 << 5, 	/**< East edge closed by the first half of a vertical wall */
+	WALL_HEAD_SOUTH = 1 << 6 	/**< South edge closed by the first half of a horizontal wall */
+};
+
+/** @enum Flags set by mark_shortest_paths(), besides (1 << d) for an edge in direction d on a shortest path */
+enum path_flag_t {
+	ON_SHORTEST_PATH = 1 << 7 	/**< The vertex is on a shortest path */
+};
+
+/** @enum State of the edge between two vertices, as returned by edge_state() */
+enum edge_state_t {
+	NO_EDGE_STATE = 0, 				/**< The vertices are not adjacent */
+	VERTICAL_WALL_HEAD = 5, 		/**< First half of a vertical wall */
+	VERTICAL_WALL_TAIL = 6, 		/**< Second half of a vertical wall */
+	HORIZONTAL_WALL_HEAD = 7, 		/**< First half of an horizontal wall */
+	HORIZONTAL_WALL_TAIL = 8 		/**< Second half of an horizontal wall */
+	// Values from NORTH to EAST mean that the edge is open in that direction
+};
+
+/** @enum Destinations of a pawn move, as bits of the masks returned by pawn_moves() */
+enum pawn_move_t {
+	STEP_NORTH, STEP_SOUTH, STEP_WEST, STEP_EAST, 		/**< To an adjacent vertex */
+	JUMP_NORTH, JUMP_SOUTH, JUMP_WEST, JUMP_EAST, 		/**< Straight over the opponent */
+	JUMP_NORTH_WEST, JUMP_NORTH_EAST, 					/**< Beside the opponent, diagonally */
+	JUMP_SOUTH_WEST, JUMP_SOUTH_EAST,
+	MAX_PAWN_MOVE
+};
+
+/** @enum Features hashed into a position key, see zobrist_key() */
+enum zobrist_kind_t {
+	ZOBRIST_WALL, 			/**< A placed wall, indexed by its identifier */
+	ZOBRIST_PAWN, 			/**< A pawn, indexed by its vertex times 2, plus its color */
+	ZOBRIST_WALLS_LEFT, 	/**< The walls left to a player, indexed by their number times 2, plus the color */
+	ZOBRIST_SIDE 			/**< WHITE is the next player to move, indexed by 0 */
+};
+
+/**
+ * @brief Get the random key of a feature of a position
+ *
+ * @details The key is the splitmix64 mix of the feature, so that every player
+ * and the server get the same keys without sharing a table
+ */
+static inline uint64_t zobrist_key(enum zobrist_kind_t kind, size_t index) {
+	uint64_t z = ((uint64_t)kind << 56 ^ index) + 0x9E3779B97F4A7C15ULL;
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	return z ^ (z >> 31);
+}
+
 /** @brief A special vertex used to specify that there is no vertex */
 static inline size_t no_vertex(void) {
 	return SIZE_MAX;
@@ -38,24 +96,131 @@ static inline bool is_no_vertex(const size_t v) {
 /** @brief Get the adjacent vertex of a vertex in a given direction */
 size_t vertex_from_direction(const struct graph_t* graph, size_t v, enum direction_t d);
 
+/** @brief Get the direction leading from src to dest, NO_DIRECTION if they are not adjacent */
+enum direction_t direction_between(const struct graph_t* graph, size_t src, size_t dest);
+
+/** @brief Get the state of the edge between src and dest */
+unsigned edge_state(const struct graph_t* graph, size_t src, size_t dest);
+
+/** @brief Get the key of a pawn on a vertex, 0 if it is not on the board */
+static inline uint64_t zobrist_pawn(enum color_t color, size_t pos) {
+	return is_no_vertex(pos) ? 0 : zobrist_key(ZOBRIST_PAWN, pos * 2 + color);
+}
+
+/** @brief Get the key of the number of walls left to a player */
+static inline uint64_t zobrist_walls_left(enum color_t color, size_t num_walls) {
+	return zobrist_key(ZOBRIST_WALLS_LEFT, num_walls * 2 + color);
+}
+
+/** @brief Get the key toggled each time the player to move changes */
+static inline uint64_t zobrist_side(void) {
+	return zobrist_key(ZOBRIST_SIDE, 0);
+}
+
+/** @brief Check if the vertex v is owned by the player of the given color */
+static inline bool is_owned(const struct graph_t* graph, enum color_t color, size_t v) {
+	return (graph->o[color][v / 64] >> (v % 64)) & 1;
+}
+
 /** @brief Check if vertex src is linked to vertex dest (i.e there is an edge between them) */
 bool is_linked(const struct graph_t* graph, size_t src, size_t dest);
 
 /** @brief Get all the linked vertices from the vertex v */
 size_t get_linked(const struct graph_t* graph, size_t v, size_t vertices[]);
 
+/** @brief Get all the linked vertices of a set of vertices */
+size_t get_linked_many(const struct graph_t* graph, const size_t vertices[], size_t count, size_t linked[][MAX_DIRECTION]);
+
 /** @brief Initialize a graph representing the game board with the given size and shape */
 struct graph_t* graph_init(size_t n, enum shape_t shape);
 
 /** @brief Free the memory allocated for a graph */
 void graph_free(struct graph_t* graph);
 
+/** @brief Remove every wall of a graph, without allocating memory */
+void graph_reset(struct graph_t* graph);
+
+/** @brief Copy the walls of a graph into a graph of the same size */
+void graph_copy(struct graph_t* dest, const struct graph_t* src);
+
+/** @brief Allocate a copy of a graph */
+struct graph_t* graph_clone(const struct graph_t* graph);
+
+/** @brief Allocate a graph reading the walls of another one, with its own search buffers */
+struct graph_t* graph_view(const struct graph_t* graph);
+
+/** @brief Update a view after walls were placed on the graph it reads */
+void graph_view_sync(struct graph_t* view, const struct graph_t* graph);
+
+/** @brief Free a view, without freeing the walls it reads */
+void graph_view_free(struct graph_t* view);
+
+/** @brief Get an empty square graph, reusing a released graph of the same size if there is one */
+struct graph_t* graph_pool_acquire(size_t m);
+
+/** @brief Give a graph back to the pool */
+void graph_pool_release(struct graph_t* graph);
+
+/** @brief Free every graph of the pool */
+void graph_pool_clear(void);
+
 /** @brief Add edges to graph */
 void place_wall(struct graph_t* graph, struct edge_t e[2]);
 
 /** @brief Remove edges from graph */
 void remove_wall(struct graph_t* graph, struct edge_t e[2]);
 
+/** @brief Check if a wall may prevent a player from reaching its arrival line */
+bool wall_may_disconnect(const struct graph_t* graph, const struct edge_t e[2]);
+
+/** @brief Allocate the wall emplacements of an empty square board of size m */
+struct wall_slots_t* wall_slots_alloc(size_t m);
+
+/** @brief Free every wall emplacement, as on an empty board */
+void wall_slots_reset(struct wall_slots_t* slots);
+
+/** @brief Free the memory allocated for wall emplacements */
+void wall_slots_free(struct wall_slots_t* slots);
+
+/** @brief Copy wall emplacements of the same size */
+void wall_slots_copy(struct wall_slots_t* dest, const struct wall_slots_t* src);
+
+/** @brief Mark the emplacements blocked by a placed wall */
+void wall_slots_place(struct wall_slots_t* slots, size_t wall);
+
+/** @brief Release the emplacements blocked by a removed wall */
+void wall_slots_remove(struct wall_slots_t* slots, size_t wall);
+
+/** @brief Get the number of free wall emplacements */
+size_t wall_slots_count(const struct wall_slots_t* slots);
+
+/** @brief Get the edges of a wall from its identifier */
+void wall_edges(size_t m, size_t wall, struct edge_t e[2]);
+
+/** @brief Mark the edges on the shortest paths between a position and the arrival line of a player */
+void mark_shortest_paths(struct graph_t* graph, size_t pos, enum color_t color, uint8_t marks[]);
+
+/** @brief Get the free walls closing a marked edge, and a few walls beside the marked vertices */
+size_t wall_candidates(const struct graph_t* graph, const uint8_t marks[], size_t num_others, size_t walls[]);
+
+/** @brief Get the legal pawn moves from the closed directions around the pawn and the opponent */
+uint16_t pawn_moves_lookup(uint8_t self_cell, uint8_t opponent_cell, enum direction_t opponent_direction);
+
+/** @brief Get the legal pawn moves of a player standing on pos */
+uint16_t pawn_moves(const struct graph_t* graph, size_t pos, size_t opponent);
+
+/** @brief Get the offset between a pawn and the destination of a move */
+long pawn_move_offset(size_t m, enum pawn_move_t move);
+
+/** @brief Get the destinations of the legal pawn moves of a player standing on pos */
+size_t get_pawn_moves(const struct graph_t* graph, size_t pos, size_t opponent, size_t destinations[MAX_PAWN_MOVE]);
+
+/** @brief Check if a player standing on pos can move to the destination */
+bool is_pawn_move(const struct graph_t* graph, size_t pos, size_t opponent, size_t destination);
+
+/** @brief Compute the hash of a position from scratch */
+uint64_t position_hash(const struct graph_t* graph, const size_t pos[2], const size_t num_walls[2], enum color_t to_move);
+
 /** @brief Get the opposite to a direction */
 enum direction_t opposite(enum direction_t d);
 
@@ -63,7 +228,19 @@ void display_board(struct graph_t* board, size_t board_size, size_t position_pla
 
 void display_adj_matrix(struct graph_t* board, size_t board_size);
 
-/** @brief Dijkstra algorithm to get the closest path */
+/** @brief Compute the distance to the arrival line of a player from every vertex */
+void distance_field(struct graph_t* graph, enum color_t color, size_t out[]);
+
+/** @brief Get the shortest distance between a position and the arrival line of a player */
 size_t dijkstra(struct graph_t *graph, size_t pos, enum color_t color);
 
+/** @brief Enable the distance fields maintained by place_wall() and remove_wall() */
+void enable_distance_fields(struct graph_t* graph);
+
+/** @brief Get a maintained distance field, NULL if they are not enabled */
+const size_t* get_distance_field(const struct graph_t* graph, enum color_t color);
+
+/** @brief Get the shortest distance to the arrival line, from the distance fields if they are enabled */
+size_t goal_distance(struct graph_t* graph, size_t pos, enum color_t color);
+
 #endif // _QUOR_BOARD_H_
@@ -0,0 +1,148 @@
+/**
+ * @file geralt.h
+ *
+ * @brief Compact game state and moves of the Geralt strategy
+ */
+
+#ifndef _QUOR_GERALT_H_
+#define _QUOR_GERALT_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "board.h"
+#include "move.h"
+
+/** @brief Largest board width handled by Geralt, its searches store distances on 16 bits */
+#define GERALT_MAX_WIDTH 255
+
+/** @brief Deepest ply of a search */
+#define MAX_PLY 128
+
+/** @brief Distance in a goal field of a vertex from which the target line can't be reached */
+#define UNREACHABLE UINT16_MAX
+
+/**
+ * @brief Moves of the search, packed in 32 bits
+ *
+ * @details Bits 28 and 29 hold the type of the move plus one, so that no move is 0,
+ * bit 24 is set for a horizontal wall and the 24 lower bits hold the head of a wall,
+ * or the signed offset of a displacement
+ */
+#define DISPLACEMENT_MOVE(inc)        ((unsigned) (MOVE + 1) << 28 | ((unsigned) (inc) & 0xFFFFFF))
+#define WALL_MOVE(corner, horizontal) ((unsigned) (WALL + 1) << 28 | (unsigned) (horizontal) << 24 | ((unsigned) (corner) & 0xFFFFFF))
+
+/** @brief Get the type of a packed move */
+#define MOVE_TYPE(move)       ((enum movetype_t) (((move) >> 28) - 1))
+/** @brief Get the head of a wall, or the offset of a displacement, of a packed move */
+#define MOVE_VALUE(move)      ((int) ((move) & 0xFFFFFF) - (int) ((move) & 0x800000) * 2)
+/** @brief Check if a packed move is a horizontal wall */
+#define MOVE_HORIZONTAL(move) ((bool) ((move) >> 24 & 1))
+
+/** @struct Game seen by the player to move, the walls are only stored as bits of the cells */
+typedef struct {
+	uint8_t *cells;             /**< Flags of each vertex, as in `struct graph_t` */
+	struct wall_slots_t *slots; /**< Free wall emplacements */
+	int width;                  /**< Number of vertices on a side of the board */
+	enum color_t color;         /**< Color of the player to move */
+	int pos;                    /**< Vertex of the player to move, -1 if not on the board yet */
+	int num_walls;
+	int opponent_pos;
+	int opponent_num_walls;
+	int *start_pos;             /**< Start positions of the player to move */
+	int *opponent_start_pos;
+	bool target_is_up;          /**< True if the player to move goes to the first line */
+	uint64_t hash;              /**< Zobrist hash of the position, see position_hash() */
+} SimpleGameState;
+
+/** @enum Result of a pawn race for the player to move */
+enum race_result_t { RACE_UNKNOWN, RACE_WIN, RACE_LOSS };
+
+/** @struct Pawn race solved by solve_race() */
+typedef struct {
+	uint64_t key;               /**< Hash of the position */
+	int plies;                  /**< Length of the race with the best play of both players, if it is solved */
+	uint8_t result;             /**< See enum race_result_t */
+	uint8_t budget;             /**< Plies searched without solving the race, if it is not solved */
+} RaceEntry;
+
+/** @struct Pawn races already solved, indexed by the hash of their position */
+typedef struct {
+	RaceEntry *entries;
+	size_t mask;
+	long nodes;                 /**< Nodes which the current call of solve_race() can still search */
+} RaceTable;
+
+/**
+ * @struct Distances to the target line of both colors at each ply of a search
+ *
+ * @details A ply shares the fields of the previous one unless a wall changes their distances,
+ * the field of a color at ply p is in the buffers of the ply owner[p][color]
+ */
+typedef struct {
+	uint16_t *buffers;          /**< Two fields of width^2 distances per ply, BLACK then WHITE */
+	int *queue;                 /**< Queue of width^2 vertices of the breadth first searches */
+	int owner[MAX_PLY][2];      /**< Ply whose buffers hold the field of each ply by color */
+	bool ready[MAX_PLY][2];     /**< True once the field in the buffers of a ply is computed, it is computed when first needed */
+} GoalFields;
+
+
+void invert_int(int *a, int *b);
+
+/** @brief Swap two pointers */
+void invert_ptr(int **a, int **b);
+
+/** @brief Give the turn to the other player, without changing the position */
+void change_side(SimpleGameState *game);
+
+/** @brief Pass the turn, a second call restores the game */
+void null_move(SimpleGameState *game);
+
+/** @brief Add the legal pawn moves of the player to move, who must be on the board */
+void add_displacement_moves(const SimpleGameState *state, unsigned *moves, int *nb_of_moves);
+
+/** @brief Play a move of the player to move, without any check */
+void apply_move(SimpleGameState *state, unsigned move);
+
+/** @brief Undo the last move applied with apply_move() */
+void undo_move(SimpleGameState *state, unsigned move);
+
+/** @brief Compute the distance of every vertex to the target line of a color, UNREACHABLE for the vertices cut from it */
+void compute_goal_field(const SimpleGameState *state, enum color_t color, uint16_t *field, int *queue);
+
+/** @brief Check that a wall, already in the cells of the state, leaves the distances of a field unchanged */
+bool wall_keeps_field(const SimpleGameState *state, const uint16_t *field, int corner, bool horizontal);
+
+/** @brief Start a search at ply 0, whose fields are not computed yet */
+void reset_goal_fields(GoalFields *fields);
+
+/** @brief Get the field of a color at a ply, computing it from the state if it is not ready */
+const uint16_t *goal_field(GoalFields *fields, const SimpleGameState *state, int ply, enum color_t color);
+
+/**
+ * @brief Give the fields of a ply to the next one after a move, already applied to the state
+ *
+ * @details The pawn moves keep the fields, and so do the walls which leave their distances unchanged
+ */
+void update_goal_fields(GoalFields *fields, const SimpleGameState *state, int ply, unsigned move);
+
+/** @brief Allocate an empty table of 2^bits pawn races */
+void race_table_init(RaceTable *table, int bits);
+
+/** @brief Free the memory allocated for a table of pawn races */
+void race_table_free(RaceTable *table);
+
+/**
+ * @brief Solve the race of a position where no player has walls left
+ *
+ * @details fields[c] is the distance of each vertex to the target line of the color c.
+ * The pawn moves are searched until the pawns can no longer meet, including the jumps
+ * and the side steps around the opponent
+ *
+ * @return RACE_WIN or RACE_LOSS for the player to move, who then reaches its line,
+ * or sees the opponent reach its own, after `*plies` plies of the best play of both
+ * players, or RACE_UNKNOWN if the race is too long to be solved
+ */
+enum race_result_t solve_race(RaceTable *table, SimpleGameState *state, const uint16_t *fields[2], int *plies);
+
+#endif // _QUOR_GERALT_H_
@@ -8,25 +8,77 @@
 #define _QUOR_GRAPH_H_
 
 #include <stddef.h>
-#include <gsl/gsl_spmatrix.h>
-#include <gsl/gsl_spmatrix_uint.h>
-#include <gsl/gsl_spblas.h>
+#include <stdint.h>
 
 #include "move.h"
 
+/** @struct Record of a placed wall, used to undo the incremental structures */
+struct wall_mark_t {
+	size_t wall;            /**< Head vertex of the wall, times 2, plus 1 if the wall is vertical */
+	size_t log_size;        /**< Size of the undo log before the wall was placed */
+};
+
+/** @struct Union-find over the wall lattice points (the corners of the vertices) */
+struct wall_sets_t {
+	size_t num_points;      /**< Number of lattice points, the last one stands for the whole border */
+	uint32_t* parent;       /**< Parent of each point, a root is its own parent */
+	uint8_t* rank;          /**< Upper bound of the height of each tree */
+	size_t* history;        /**< Stack of unions, root attached times 2, plus 1 if the rank of the new root grew */
+	size_t history_size;    /**< Number of unions in the stack */
+	struct wall_mark_t* marks; /**< Stack of the walls that can be undone with the history */
+	size_t num_marks;       /**< Number of walls in the stack */
+	size_t marks_capacity;  /**< Number of walls the stack can hold */
+};
+
+/** @struct Free wall emplacements, indexed by wall identifier (see `struct wall_mark_t`) */
+struct wall_slots_t {
+	size_t width;           /**< Number of vertices on a side of the board */
+	size_t words;           /**< Number of words of each bitset */
+	uint64_t* free[2];      /**< free[o] bit v set means a wall of orientation o can have v as head */
+	uint8_t* blockers;      /**< Number of placed walls overlapping or crossing each wall */
+	uint32_t (*conflicts)[4]; /**< Walls overlapping or crossing each wall, itself included, UINT32_MAX if none */
+};
+
+/** @struct Goal distance fields kept up to date by place_wall() and remove_wall() */
+struct distance_fields_t {
+	size_t* d[2];           /**< Distance to the arrival line of each player from every vertex */
+	size_t* log;            /**< Undo log of (color * n + vertex, previous distance) pairs */
+	size_t log_size;        /**< Number of values in the log */
+	size_t log_capacity;    /**< Number of values the log can hold */
+	struct wall_mark_t* marks; /**< Stack of the walls that can be undone with the log */
+	size_t num_marks;       /**< Number of walls in the stack */
+	size_t marks_capacity;  /**< Number of walls the stack can hold */
+	size_t* work;           /**< Buffer of 7 * n + 4 vertices used by the repairs */
+	uint8_t* state;         /**< State of each vertex during a repair */
+};
+
 /** @struct Struct representing a game graph */
 struct graph_t {
 	size_t num_vertices;    /**< Number of vertices in the graph */
-	gsl_spmatrix_uint* t;   /**< Sparse matrix of size n*n
-							* - t[i][j] > 0 means there is an edge from i to j
-							* - t[i][j] == 1 means that j is NORTH of i
-							* - t[i][j] == 2 means that j is SOUTH of i
-							* - t[i][j] == 3 means that j is WEST  of i
-							* - t[i][j] == 4 means that j is EAST  of i
+	size_t width;           /**< Number of vertices on a side of the board */
+	uint8_t* cells;         /**< Array of size n, one byte of flags per vertex
+							* - bit (1 << d) set means there is no edge from i in direction d
+							*   (either the border of the board or a wall)
+							* - WALL_HEAD_EAST set means that the east edge of i is closed
+							*   by the first half of a vertical wall
+							* - WALL_HEAD_SOUTH set means that the south edge of i is closed
+							*   by the first half of a horizontal wall
 							*/
-	gsl_spmatrix_uint* o;   /**< Sparse matrix of size 2*n, one line per player
-							* - o[p][i] == 1 means that the vertex i is owned by p
+	uint64_t* o[2];         /**< Two bitsets of n bits, one per player
+							* - bit i of o[p] set means that the vertex i is owned by p
 							*/
+	size_t* scratch;        /**< Buffer of n vertices reused by the path searches */
+	size_t* distances;      /**< Buffer of 2n distances reused by the path searches */
+	struct distance_fields_t* fields; /**< Maintained distance fields, NULL if not enabled */
+	struct wall_sets_t* wall_sets; /**< Connected sets of walls, including the border */
+	struct wall_slots_t* wall_slots; /**< Emplacements where a wall can be placed */
+	uint64_t hash;          /**< Zobrist hash of the placed walls */
+};
+
+/** @struct Read-only view of the board of the server, shared with the players */
+struct graph_snapshot_t {
+	const struct graph_t* graph; /**< Board of the server, never modified by the players */
+	size_t version;         /**< Incremented each time a wall is placed on the board */
 };
 
 #endif // _QUOR_GRAPH_H_
@@ -22,6 +22,7 @@ struct game_state_t {
 	struct graph_t* graph; 			/**< Graph representing the game board */
 	struct player_state_t self; 	/**< State of the current player */
 	struct player_state_t opponent; /**< State of the opponent */
+	struct move_t previous_move; 	/**< Last move of the opponent, of type NO_TYPE before it has played */
 };
 
 /** @brief Return a first move based on the IA strategy */
@@ -16,6 +16,9 @@ char const* get_player_name(void);
 /** @brief Initialize the player */
 void initialize(enum color_t id, struct graph_t* graph, size_t num_walls);
 
+/** @brief Initialize the player with a board shared by the server, this function is optional */
+void initialize_shared(enum color_t id, const struct graph_snapshot_t* snapshot, size_t num_walls);
+
 /** @brief Computes next move */
 struct move_t play(struct move_t previous_move);
 
@@ -0,0 +1,391 @@
+/**
+ * @file bitboard.c
+ *
+ * @brief Reachability and distance computations on bitboards
+ *
+ * @details A bitboard stores one bit per vertex, so a whole set of vertices fits in a few words.
+ * A breadth first search layer is computed for all the frontier at once with masked shifts:
+ * `frontier |= shift(frontier & open[d])` for each direction `d`, where moving north or south
+ * is a shift by the width of the board and moving west or east is a shift by one. \n
+ * Planes are surrounded by zero words so shifted loads never leave the allocation,
+ * which allows the same loop to be written with 64, 128 or 256 bits registers.
+ */
+
+#include "bitboard.h"
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define BITBOARD_X86
+#include <immintrin.h>
+#endif
+
+/** @enum Flags returned by the flood fill kernels */
+enum expand_result_t {
+	EXPAND_GREW = 1, 	/**< At least one vertex has been added */
+	EXPAND_GOAL = 2 	/**< The result contains a vertex of the goal */
+};
+
+/**
+ * @brief Compute one layer of breadth first search, 64 bits at a time
+ *
+ * @param bb The bitboard processed
+ * @param dst The plane receiving `src` and all its neighbours
+ * @param src The plane holding the current set of vertices
+ * @param goal The plane holding the target vertices
+ *
+ * @return A combination of `enum expand_result_t` flags
+ */
+static int expand_scalar(const struct bitboard_t* bb, uint64_t* dst, const uint64_t* src, const uint64_t* goal) {
+	const uint64_t* on = bb->open[NORTH];
+	const uint64_t* os = bb->open[SOUTH];
+	const uint64_t* ow = bb->open[WEST];
+	const uint64_t* oe = bb->open[EAST];
+	ptrdiff_t q = bb->width / 64;
+	unsigned r = bb->width % 64;
+	uint64_t grew = 0;
+	uint64_t hit = 0;
+
+	for (ptrdiff_t i = 0; i < (ptrdiff_t)bb->words; i++) {
+		uint64_t x = src[i];
+
+		x |= (src[i + q] & on[i + q]) >> r;
+		x |= (src[i - q] & os[i - q]) << r;
+		if (r != 0) {
+			x |= (src[i + q + 1] & on[i + q + 1]) << (64 - r);
+			x |= (src[i - q - 1] & os[i - q - 1]) >> (64 - r);
+		}
+		x |= ((src[i] & ow[i]) >> 1) | ((src[i + 1] & ow[i + 1]) << 63);
+		x |= ((src[i] & oe[i]) << 1) | ((src[i - 1] & oe[i - 1]) >> 63);
+
+		dst[i] = x;
+		grew |= x ^ src[i];
+		hit |= x & goal[i];
+	}
+
+	return (grew ? EXPAND_GREW : 0) | (hit ? EXPAND_GOAL : 0);
+}
+
+#ifdef BITBOARD_X86
+
+/** @brief Same as expand_scalar(), 128 bits at a time */
+__attribute__((target("sse2")))
+static int expand_sse2(const struct bitboard_t* bb, uint64_t* dst, const uint64_t* src, const uint64_t* goal) {
+#define LOAD(p, i) _mm_loadu_si128((const __m128i*)((p) + (i)))
+#define MASKED(p, o, i) _mm_and_si128(LOAD(p, i), LOAD(o, i))
+	const uint64_t* on = bb->open[NORTH];
+	const uint64_t* os = bb->open[SOUTH];
+	const uint64_t* ow = bb->open[WEST];
+	const uint64_t* oe = bb->open[EAST];
+	ptrdiff_t q = bb->width / 64;
+	__m128i r = _mm_cvtsi32_si128(bb->width % 64);
+	__m128i l = _mm_cvtsi32_si128(64 - bb->width % 64);
+	__m128i grew = _mm_setzero_si128();
+	__m128i hit = _mm_setzero_si128();
+
+	for (ptrdiff_t i = 0; i < (ptrdiff_t)bb->words; i += 2) {
+		__m128i s = LOAD(src, i);
+		__m128i x = s;
+
+		x = _mm_or_si128(x, _mm_srl_epi64(MASKED(src, on, i + q), r));
+		x = _mm_or_si128(x, _mm_sll_epi64(MASKED(src, on, i + q + 1), l));
+		x = _mm_or_si128(x, _mm_sll_epi64(MASKED(src, os, i - q), r));
+		x = _mm_or_si128(x, _mm_srl_epi64(MASKED(src, os, i - q - 1), l));
+		x = _mm_or_si128(x, _mm_srli_epi64(MASKED(src, ow, i), 1));
+		x = _mm_or_si128(x, _mm_slli_epi64(MASKED(src, ow, i + 1), 63));
+		x = _mm_or_si128(x, _mm_slli_epi64(MASKED(src, oe, i), 1));
+		x = _mm_or_si128(x, _mm_srli_epi64(MASKED(src, oe, i - 1), 63));
+
+		_mm_storeu_si128((__m128i*)(dst + i), x);
+		grew = _mm_or_si128(grew, _mm_xor_si128(x, s));
+		hit = _mm_or_si128(hit, _mm_and_si128(x, LOAD(goal, i)));
+	}
+
+	__m128i zero = _mm_setzero_si128();
+	int grew_zero = _mm_movemask_epi8(_mm_cmpeq_epi8(grew, zero)) == 0xFFFF;
+	int hit_zero = _mm_movemask_epi8(_mm_cmpeq_epi8(hit, zero)) == 0xFFFF;
+	return (grew_zero ? 0 : EXPAND_GREW) | (hit_zero ? 0 : EXPAND_GOAL);
+#undef MASKED
+#undef LOAD
+}
+
+/** @brief Same as expand_scalar(), 256 bits at a time */
+__attribute__((target("avx2")))
+static int expand_avx2(const struct bitboard_t* bb, uint64_t* dst, const uint64_t* src, const uint64_t* goal) {
+#define LOAD(p, i) _mm256_loadu_si256((const __m256i*)((p) + (i)))
+#define MASKED(p, o, i) _mm256_and_si256(LOAD(p, i), LOAD(o, i))
+	const uint64_t* on = bb->open[NORTH];
+	const uint64_t* os = bb->open[SOUTH];
+	const uint64_t* ow = bb->open[WEST];
+	const uint64_t* oe = bb->open[EAST];
+	ptrdiff_t q = bb->width / 64;
+	__m128i r = _mm_cvtsi32_si128(bb->width % 64);
+	__m128i l = _mm_cvtsi32_si128(64 - bb->width % 64);
+	__m256i grew = _mm256_setzero_si256();
+	__m256i hit = _mm256_setzero_si256();
+
+	for (ptrdiff_t i = 0; i < (ptrdiff_t)bb->words; i += 4) {
+		__m256i s = LOAD(src, i);
+		__m256i x = s;
+
+		x = _mm256_or_si256(x, _mm256_srl_epi64(MASKED(src, on, i + q), r));
+		x = _mm256_or_si256(x, _mm256_sll_epi64(MASKED(src, on, i + q + 1), l));
+		x = _mm256_or_si256(x, _mm256_sll_epi64(MASKED(src, os, i - q), r));
+		x = _mm256_or_si256(x, _mm256_srl_epi64(MASKED(src, os, i - q - 1), l));
+		x = _mm256_or_si256(x, _mm256_srli_epi64(MASKED(src, ow, i), 1));
+		x = _mm256_or_si256(x, _mm256_slli_epi64(MASKED(src, ow, i + 1), 63));
+		x = _mm256_or_si256(x, _mm256_slli_epi64(MASKED(src, oe, i), 1));
+		x = _mm256_or_si256(x, _mm256_srli_epi64(MASKED(src, oe, i - 1), 63));
+
+		_mm256_storeu_si256((__m256i*)(dst + i), x);
+		grew = _mm256_or_si256(grew, _mm256_xor_si256(x, s));
+		hit = _mm256_or_si256(hit, _mm256_and_si256(x, LOAD(goal, i)));
+	}
+
+	return (_mm256_testz_si256(grew, grew) ? 0 : EXPAND_GREW)
+		| (_mm256_testz_si256(hit, hit) ? 0 : EXPAND_GOAL);
+#undef MASKED
+#undef LOAD
+}
+
+#endif // BITBOARD_X86
+
+/** Flood fill kernel used by the searches, chosen on first use */
+static int (*expand)(const struct bitboard_t* bb, uint64_t* dst, const uint64_t* src, const uint64_t* goal) = NULL;
+
+/**
+ * @brief Choose the flood fill implementation
+ *
+ * @param impl The wanted implementation, `BITBOARD_AUTO` selects the widest one supported
+ *
+ * @return True if the implementation is supported by the processor, else false
+ * and the current implementation is kept
+ */
+bool bitboard_select(enum bitboard_impl_t impl) {
+#ifdef BITBOARD_X86
+	__builtin_cpu_init();
+	bool sse2 = __builtin_cpu_supports("sse2");
+	bool avx2 = __builtin_cpu_supports("avx2");
+
+	switch (impl) {
+	case BITBOARD_AUTO:
+		expand = avx2 ? expand_avx2 : sse2 ? expand_sse2 : expand_scalar;
+		return true;
+	case BITBOARD_SCALAR:
+		expand = expand_scalar;
+		return true;
+	case BITBOARD_SSE2:
+		if (sse2)
+			expand = expand_sse2;
+		return sse2;
+	case BITBOARD_AVX2:
+		if (avx2)
+			expand = expand_avx2;
+		return avx2;
+	}
+	return false;
+#else
+	if (impl == BITBOARD_AUTO || impl == BITBOARD_SCALAR) {
+		expand = expand_scalar;
+		return true;
+	}
+	return false;
+#endif
+}
+
+/**
+ * @brief Allocate a bitboard for a square board
+ *
+ * @details All the edges are closed until bitboard_load() is called
+ *
+ * @param m The size of the square sides
+ *
+ * @return A bitboard that must be freed with bitboard_free()
+ */
+struct bitboard_t* bitboard_alloc(size_t m) {
+	struct bitboard_t* bb = malloc(sizeof(*bb));
+	size_t n = m * m;
+
+	// Round up to a whole number of 256 bits registers
+	size_t pad = (m / 64 + 2 + 3) / 4 * 4;
+	bb->num_vertices = n;
+	bb->width = m;
+	bb->words = ((n + 63) / 64 + 3) / 4 * 4;
+	bb->stride = pad + bb->words + pad;
+
+	// Four edge planes, two goal planes and two work planes
+	bb->planes = calloc(8 * bb->stride, sizeof(uint64_t));
+	uint64_t* plane = bb->planes + pad;
+
+	bb->open[NO_DIRECTION] = NULL;
+	for (enum direction_t d = NORTH; d < MAX_DIRECTION; d++, plane += bb->stride)
+		bb->open[d] = plane;
+	for (size_t i = 0; i < 2; i++, plane += bb->stride)
+		bb->goal[i] = plane;
+	for (size_t i = 0; i < 2; i++, plane += bb->stride)
+		bb->work[i] = plane;
+
+	return bb;
+}
+
+/**
+ * @brief Free the memory allocated for a bitboard
+ *
+ * @param bb The bitboard to free
+ */
+void bitboard_free(struct bitboard_t* bb) {
+	free(bb->planes);
+	free(bb);
+}
+
+/**
+ * @brief Copy the edges and the arrival lines of a graph into a bitboard
+ *
+ * @param bb The bitboard to fill, allocated for the size of the graph
+ * @param graph The graph processed
+ */
+void bitboard_load(struct bitboard_t* bb, const struct graph_t* graph) {
+	for (size_t w = 0; w < bb->words; w++) {
+		uint64_t open[MAX_DIRECTION] = { 0 };
+
+		for (size_t v = w * 64; v < (w + 1) * 64 && v < bb->num_vertices; v++) {
+			uint8_t closed = graph->cells[v];
+			for (enum direction_t d = NORTH; d < MAX_DIRECTION; d++)
+				open[d] |= (uint64_t)!(closed & (1 << d)) << (v % 64);
+		}
+
+		for (enum direction_t d = NORTH; d < MAX_DIRECTION; d++)
+			bb->open[d][w] = open[d];
+
+		// The arrival line of a player is owned by its opponent
+		bool in_board = w < (bb->num_vertices + 63) / 64;
+		bb->goal[BLACK][w] = in_board ? graph->o[WHITE][w] : 0;
+		bb->goal[WHITE][w] = in_board ? graph->o[BLACK][w] : 0;
+	}
+}
+
+/**
+ * @brief Clear a bit in a plane
+ */
+static inline void clear_bit(uint64_t* plane, size_t v) {
+	plane[v / 64] &= ~((uint64_t)1 << (v % 64));
+}
+
+/**
+ * @brief Set a bit in a plane
+ */
+static inline void set_bit(uint64_t* plane, size_t v) {
+	plane[v / 64] |= (uint64_t)1 << (v % 64);
+}
+
+/**
+ * @brief Close the two edges of a wall in a bitboard
+ *
+ * @details The edges are closed in both directions, whatever the order of their vertices
+ *
+ * @param bb The bitboard to update
+ * @param e An array of two edges representing a wall
+ */
+void bitboard_close_wall(struct bitboard_t* bb, const struct edge_t e[2]) {
+	for (size_t i = 0; i < 2; i++) {
+		size_t a = e[i].fr < e[i].to ? e[i].fr : e[i].to;
+		size_t b = e[i].fr < e[i].to ? e[i].to : e[i].fr;
+
+		if (a + 1 == b) {
+			clear_bit(bb->open[EAST], a);
+			clear_bit(bb->open[WEST], b);
+		}
+		else {
+			clear_bit(bb->open[SOUTH], a);
+			clear_bit(bb->open[NORTH], b);
+		}
+	}
+}
+
+/**
+ * @brief Open again the two edges of a wall closed by bitboard_close_wall()
+ *
+ * @details The edges must have been open before the wall was closed, the words of the
+ * planes then get back their previous value
+ *
+ * @param bb The bitboard to update
+ * @param e An array of two edges representing a wall
+ */
+void bitboard_open_wall(struct bitboard_t* bb, const struct edge_t e[2]) {
+	for (size_t i = 0; i < 2; i++) {
+		size_t a = e[i].fr < e[i].to ? e[i].fr : e[i].to;
+		size_t b = e[i].fr < e[i].to ? e[i].to : e[i].fr;
+
+		if (a + 1 == b) {
+			set_bit(bb->open[EAST], a);
+			set_bit(bb->open[WEST], b);
+		}
+		else {
+			set_bit(bb->open[SOUTH], a);
+			set_bit(bb->open[NORTH], b);
+		}
+	}
+}
+
+/**
+ * @brief Get the shortest distance between a position and the arrival line of a player
+ *
+ * @details Each iteration adds a whole breadth first search layer to the reached set,
+ * the search stops when the arrival line is reached or when the set stops growing. \n
+ * If the player is not on the board yet, the distance is computed from its starting line,
+ * counting the first move
+ *
+ * @param bb The bitboard processed
+ * @param pos The position of the player
+ * @param color The color of the player
+ *
+ * @return The distance to the arrival line, IMPOSSIBLE_DISTANCE if it can not be reached
+ */
+size_t bitboard_distance(struct bitboard_t* bb, size_t pos, enum color_t color) {
+	if (expand == NULL)
+		bitboard_select(BITBOARD_AUTO);
+
+	uint64_t* src = bb->work[0];
+	uint64_t* dst = bb->work[1];
+	const uint64_t* goal = bb->goal[color];
+	size_t distance;
+
+	if (pos < bb->num_vertices) {
+		memset(src, 0, bb->words * sizeof(uint64_t));
+		src[pos / 64] = (uint64_t)1 << (pos % 64);
+		if ((goal[pos / 64] >> (pos % 64)) & 1)
+			return 0;
+		distance = 0;
+	}
+	else {
+		// The starting line of a player is the arrival line of its opponent
+		memcpy(src, bb->goal[1 - color], bb->words * sizeof(uint64_t));
+		distance = 1;
+	}
+
+	while (true) {
+		int result = expand(bb, dst, src, goal);
+		distance++;
+
+		if (result & EXPAND_GOAL)
+			return distance;
+		if (!(result & EXPAND_GREW))
+			return IMPOSSIBLE_DISTANCE;
+
+		uint64_t* tmp = src;
+		src = dst;
+		dst = tmp;
+	}
+}
+
+/**
+ * @brief Check if a player can reach its arrival line from a position
+ *
+ * @param bb The bitboard processed
+ * @param pos The position of the player
+ * @param color The color of the player
+ *
+ * @return True if there is a path to the arrival line, else false
+ */
+bool bitboard_can_reach(struct bitboard_t* bb, size_t pos, enum color_t color) {
+	return bitboard_distance(bb, pos, color) != IMPOSSIBLE_DISTANCE;
+}
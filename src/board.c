@@ -5,7 +5,6 @@
  */
 
 #include "board.h"
-#include <gsl/gsl_spmatrix.h>
 #include <string.h>
 #include <math.h>
 
@@ -13,9 +12,40 @@
 //// Graph structure manipulation functions
 // TODO Separate graph init and others operations
 
+static void fields_wall_placed(struct graph_t* graph, size_t wall, const size_t ends[4]);
+static void fields_wall_removed(struct graph_t* graph, size_t wall);
+static void wall_sets_rebuild(struct graph_t* graph);
+static void wall_sets_placed(struct graph_t* graph, size_t wall);
+static void wall_sets_removed(struct graph_t* graph, size_t wall);
+static void pawn_table_init(void);
+
+/** Legal pawn moves indexed by the opponent direction, then the closed directions of the pawn and of the opponent */
+static uint16_t pawn_table[MAX_DIRECTION][16][16];
+static bool pawn_table_ready = false;
+
+/**
+ * @brief Close the border of the board and open every other edge
+ *
+ * @param graph The graph processed
+ */
+static void reset_cells(struct graph_t* graph) {
+	size_t n = graph->num_vertices;
+	size_t m = graph->width;
+
+	for (size_t i = 0; i < n; ++i) {
+		graph->cells[i] = (i < m ? CLOSED_NORTH : 0)
+			| (i >= n - m ? CLOSED_SOUTH : 0)
+			| (i % m == 0 ? CLOSED_WEST : 0)
+			| (i % m == m - 1 ? CLOSED_EAST : 0);
+	}
+}
+
 /**
  * @brief Initialize a square graph
  *
+ * @details Every vertex is linked to its four neighbours, except on the border
+ * where the missing directions are closed
+ *
  * @param m An integer setting the size of the square sides
  *
  * @return A graph representing a square board
@@ -25,36 +55,47 @@ struct graph_t* square_init(size_t m) {
 
 	size_t n = m * m;
 	graph->num_vertices = n;
+	graph->width = m;
 
 	// Initialize the actual board
-	graph->t = gsl_spmatrix_uint_alloc(n, n);
+	graph->cells = malloc(n * sizeof(*graph->cells));
+	reset_cells(graph);
 
-	// Fill the whole graph with 0
-	gsl_spmatrix_uint_set_zero(graph->t);
+	// Initialize the buffers used by path searches
+	graph->scratch = malloc(n * sizeof(*graph->scratch));
+	graph->distances = malloc(2 * n * sizeof(*graph->distances));
 
-	// Fill the strict bottom corner
-	for (size_t i = 0; i < n; ++i) {
-		for (size_t j = 0; j < i; ++j) {
+	// Distance fields are only maintained on demand
+	graph->fields = NULL;
 
-			if (j % m != m - 1 && i == j + 1) {
-				gsl_spmatrix_uint_set(graph->t, i, j, 3);
-				gsl_spmatrix_uint_set(graph->t, j, i, 4);
-			}
+	// Initialize the wall sets, with the border as a single set
+	struct wall_sets_t* sets = malloc(sizeof(*sets));
+	sets->num_points = (m + 1) * (m + 1) + 1;
+	sets->parent = malloc(sets->num_points * sizeof(*sets->parent));
+	sets->rank = malloc(sets->num_points * sizeof(*sets->rank));
+	sets->history = malloc(sets->num_points * sizeof(*sets->history));
+	sets->marks_capacity = 16;
+	sets->marks = malloc(sets->marks_capacity * sizeof(*sets->marks));
+	graph->wall_sets = sets;
 
-			if (j / m < m - 1 && i == j + m - 1) {
-				gsl_spmatrix_uint_set(graph->t, i + 1, j, 1);
-				gsl_spmatrix_uint_set(graph->t, j, i + 1, 2);
-			}
-		}
-	}
+	graph->wall_slots = wall_slots_alloc(m);
+	graph->hash = 0;
+
+	// The table of the pawn moves is shared by every graph
+	if (!pawn_table_ready)
+		pawn_table_init();
 
-	// Initialize proprietary matrix
-	graph->o = gsl_spmatrix_uint_alloc(2, n);
+	// Initialize ownership bitsets
+	size_t words = (n + 63) / 64;
+	graph->o[BLACK] = calloc(2 * words, sizeof(uint64_t));
+	graph->o[WHITE] = graph->o[BLACK] + words;
 	for (size_t i = 0; i < m; i++) {
-		gsl_spmatrix_uint_set(graph->o, BLACK, i, 1);
-		gsl_spmatrix_uint_set(graph->o, WHITE, n - i - 1, 1);
+		graph->o[BLACK][i / 64] |= (uint64_t)1 << (i % 64);
+		graph->o[WHITE][(n - i - 1) / 64] |= (uint64_t)1 << ((n - i - 1) % 64);
 	}
 
+	wall_sets_rebuild(graph);
+
 	return graph;
 }
 
@@ -84,11 +125,178 @@ struct graph_t* graph_init(size_t m, enum shape_t shape) {
  */
 
 void graph_free(struct graph_t* graph) {
-	gsl_spmatrix_uint_free(graph->t);
-	gsl_spmatrix_uint_free(graph->o);
+	free(graph->cells);
+	free(graph->o[BLACK]);
+	free(graph->scratch);
+	free(graph->distances);
+	if (graph->fields != NULL) {
+		free(graph->fields->d[BLACK]);
+		free(graph->fields->log);
+		free(graph->fields->marks);
+		free(graph->fields->work);
+		free(graph->fields->state);
+		free(graph->fields);
+	}
+	free(graph->wall_sets->parent);
+	free(graph->wall_sets->rank);
+	free(graph->wall_sets->history);
+	free(graph->wall_sets->marks);
+	free(graph->wall_sets);
+	wall_slots_free(graph->wall_slots);
 	free(graph);
 }
 
+/**
+ * @brief Recompute the maintained structures from the cells of a graph
+ *
+ * @details The wall sets and the distance fields lose their undo history
+ *
+ * @param graph The graph processed
+ */
+static void rebuild_from_cells(struct graph_t* graph) {
+	wall_sets_rebuild(graph);
+
+	if (graph->fields != NULL) {
+		graph->fields->log_size = 0;
+		graph->fields->num_marks = 0;
+		distance_field(graph, BLACK, graph->fields->d[BLACK]);
+		distance_field(graph, WHITE, graph->fields->d[WHITE]);
+	}
+}
+
+/**
+ * @brief Remove every wall of a graph, without allocating memory
+ *
+ * @param graph The graph to reset
+ */
+void graph_reset(struct graph_t* graph) {
+	reset_cells(graph);
+	wall_slots_reset(graph->wall_slots);
+	graph->hash = 0;
+	rebuild_from_cells(graph);
+}
+
+/**
+ * @brief Copy the walls of a graph into a graph of the same size
+ *
+ * @details The distance fields of dest are kept enabled if they were
+ *
+ * @param dest The graph overwritten
+ * @param src The graph copied
+ */
+void graph_copy(struct graph_t* dest, const struct graph_t* src) {
+	memcpy(dest->cells, src->cells, src->num_vertices * sizeof(*src->cells));
+	wall_slots_copy(dest->wall_slots, src->wall_slots);
+	dest->hash = src->hash;
+	rebuild_from_cells(dest);
+}
+
+/**
+ * @brief Allocate a copy of a graph
+ *
+ * @param graph The graph copied
+ *
+ * @return A new graph with the same walls, to be freed with graph_free()
+ */
+struct graph_t* graph_clone(const struct graph_t* graph) {
+	struct graph_t* clone = graph_init(graph->width, SQUARE);
+	graph_copy(clone, graph);
+	return clone;
+}
+
+/**
+ * @brief Allocate a graph reading the walls of another one, with its own search buffers
+ *
+ * @details The cells, the owned vertices, the wall sets, the emplacements and the distance
+ * fields are the ones of `graph`, so the view sees the walls placed on it, but the path
+ * searches only write to the buffers of the view. \n
+ * No wall must be placed on the view, and the distance fields must not be enabled on it
+ *
+ * @param graph The graph read
+ *
+ * @return A view of the graph, to be freed with graph_view_free()
+ */
+struct graph_t* graph_view(const struct graph_t* graph) {
+	struct graph_t* view = malloc(sizeof(*view));
+	*view = *graph;
+	view->scratch = malloc(graph->num_vertices * sizeof(*view->scratch));
+	view->distances = malloc(2 * graph->num_vertices * sizeof(*view->distances));
+	return view;
+}
+
+/**
+ * @brief Update a view after walls were placed on the graph it reads
+ *
+ * @param view The view updated
+ * @param graph The graph read by the view
+ */
+void graph_view_sync(struct graph_t* view, const struct graph_t* graph) {
+	view->fields = graph->fields;
+	view->hash = graph->hash;
+}
+
+/**
+ * @brief Free a view, without freeing the walls it reads
+ *
+ * @param view The view to free
+ */
+void graph_view_free(struct graph_t* view) {
+	free(view->scratch);
+	free(view->distances);
+	free(view);
+}
+
+//// Graph pool
+
+/** Graphs released with graph_pool_release(), ready to be reused */
+static struct graph_t** graph_pool = NULL;
+static size_t graph_pool_size = 0;
+static size_t graph_pool_capacity = 0;
+
+/**
+ * @brief Get an empty square graph, reusing a released graph of the same size if there is one
+ *
+ * @param m The size of the board
+ *
+ * @return An empty graph, to be given back with graph_pool_release()
+ */
+struct graph_t* graph_pool_acquire(size_t m) {
+	for (size_t i = 0; i < graph_pool_size; i++) {
+		if (graph_pool[i]->width == m) {
+			struct graph_t* graph = graph_pool[i];
+			graph_pool[i] = graph_pool[--graph_pool_size];
+			graph_reset(graph);
+			return graph;
+		}
+	}
+	return graph_init(m, SQUARE);
+}
+
+/**
+ * @brief Give a graph back to the pool, its memory is kept for a later graph_pool_acquire()
+ *
+ * @param graph The graph released
+ */
+void graph_pool_release(struct graph_t* graph) {
+	if (graph_pool_size == graph_pool_capacity) {
+		graph_pool_capacity = graph_pool_capacity == 0 ? 4 : 2 * graph_pool_capacity;
+		graph_pool = realloc(graph_pool, graph_pool_capacity * sizeof(*graph_pool));
+	}
+	graph_pool[graph_pool_size++] = graph;
+}
+
+/**
+ * @brief Free every graph of the pool
+ */
+void graph_pool_clear(void) {
+	for (size_t i = 0; i < graph_pool_size; i++)
+		graph_free(graph_pool[i]);
+	free(graph_pool);
+	graph_pool = NULL;
+	graph_pool_size = 0;
+	graph_pool_capacity = 0;
+}
+
 /**
  * @brief Sort the edges representing a wall in increasing order
  *
@@ -118,16 +326,20 @@ void sort_edges(struct edge_t e[2]) {
  *  @brief Add edges to graph
  *
  * @details Add the wall represented by the two edges in `e` in `graph` \n
- * Change vertices values in the graph matrix
- * by 5 and 6 for the src and dest edge respectively if the wall is vertical
- * or by 7 and 8 respectively if the wall is horizontal \n
- * The wall is supposed to be valid
+ * Close the four directions crossed by the wall and mark the first half
+ * of the wall with `WALL_HEAD_EAST` if the wall is vertical
+ * or `WALL_HEAD_SOUTH` if the wall is horizontal \n
+ * The wall is joined to the walls it touches in the wall sets \n
+ * The emplacements overlapping or crossing the wall are no longer free \n
+ * The key of the wall is added to the hash of the graph \n
+ * If distance fields are enabled, they are repaired where the wall changes the distances \n
+ * The wall is supposed to be valid, a wall already placed is left as it is
  *
  * @param graph The graph to update
  * @param e An array of two edges representing a wall
  */
 void place_wall(struct graph_t* graph, struct edge_t e[2]) {
-	size_t board_size = (size_t)sqrtl(graph->num_vertices);
+	size_t board_size = graph->width;
 
 	// Copy values so they can be modified, then sort them
 	e = (struct edge_t[2]){ e[0], e[1] };
@@ -137,22 +349,38 @@ void place_wall(struct graph_t* graph, struct edge_t e[2]) {
 	size_t first_node = e[0].fr;
 	size_t second_node = e[0].to;
 
+	// Placing a wall twice would count it twice in the wall slots and the wall sets, and cancel its key in the hash
+	if (graph->cells[first_node] & (first_node + 1 == second_node ? WALL_HEAD_EAST : WALL_HEAD_SOUTH)) {
+		return;
+	}
+
 	if (first_node + 1 == second_node) {
 		// Vertical wall
-		gsl_spmatrix_uint_set(graph->t, first_node, second_node, 5);
-		gsl_spmatrix_uint_set(graph->t, second_node, first_node, 5);
-
-		gsl_spmatrix_uint_set(graph->t, first_node + board_size, second_node + board_size, 6);
-		gsl_spmatrix_uint_set(graph->t, second_node + board_size, first_node + board_size, 6);
+		graph->cells[first_node] |= CLOSED_EAST | WALL_HEAD_EAST;
+		graph->cells[second_node] |= CLOSED_WEST;
 
+		graph->cells[first_node + board_size] |= CLOSED_EAST;
+		graph->cells[second_node + board_size] |= CLOSED_WEST;
 	}
 	else {
 		// Horizontal wall
-		gsl_spmatrix_uint_set(graph->t, first_node, second_node, 7);
-		gsl_spmatrix_uint_set(graph->t, second_node, first_node, 7);
+		graph->cells[first_node] |= CLOSED_SOUTH | WALL_HEAD_SOUTH;
+		graph->cells[second_node] |= CLOSED_NORTH;
 
-		gsl_spmatrix_uint_set(graph->t, first_node + 1, second_node + 1, 8);
-		gsl_spmatrix_uint_set(graph->t, second_node + 1, first_node + 1, 8);
+		graph->cells[first_node + 1] |= CLOSED_SOUTH;
+		graph->cells[second_node + 1] |= CLOSED_NORTH;
+	}
+
+	bool vertical = first_node + 1 == second_node;
+	size_t wall = first_node * 2 + vertical;
+	wall_sets_placed(graph, wall);
+	wall_slots_place(graph->wall_slots, wall);
+	graph->hash ^= zobrist_key(ZOBRIST_WALL, wall);
+
+	if (graph->fields != NULL) {
+		size_t shift = vertical ? board_size : 1;
+		size_t ends[4] = { first_node, second_node, first_node + shift, second_node + shift };
+		fields_wall_placed(graph, wall, ends);
 	}
 }
 
@@ -160,59 +388,54 @@ void place_wall(struct graph_t* graph, struct edge_t e[2]) {
  * @brief Remove edges from graph
  *
  * @details Remove the wall represented by the two edges in `e` from `graph` \n
- * Change vertices values in the graph matrix by their corresponding direction
+ * Reopen the four directions closed by the wall \n
+ * The wall sets are rolled back when the wall is the last one placed, else they are built again \n
+ * If distance fields are enabled, they are restored from the undo log when the wall
+ * is the last one placed, else they are computed again
  *
  * @param graph The graph to update
  * @param e An array of two edges representing a wall
  */
 void remove_wall(struct graph_t* graph, struct edge_t e[2]) {
-	/*
-	// get nodes
+	size_t board_size = graph->width;
+
+	// Copy values so they can be modified, then sort them
+	e = (struct edge_t[2]){ e[0], e[1] };
+	sort_edges(e);
+
+	// Get nodes
 	size_t first_node = e[0].fr;
 	size_t second_node = e[0].to;
 
-	// sort nodes
-	if (first_node > second_node) {
-		size_t tmp = first_node;
-		first_node = second_node;
-		second_node = tmp;
-	}
-	*/
-	if (gsl_spmatrix_uint_get(graph->t, e[0].fr, e[0].to) == 5
-		|| gsl_spmatrix_uint_get(graph->t, e[0].fr, e[0].to) == 6) {
-		gsl_spmatrix_uint_set(graph->t, e[0].fr, e[0].to, EAST);
-		gsl_spmatrix_uint_set(graph->t, e[0].to, e[0].fr, WEST);
+	if (first_node + 1 == second_node && (graph->cells[first_node] & WALL_HEAD_EAST)) {
+		// Vertical wall
+		graph->cells[first_node] &= ~(CLOSED_EAST | WALL_HEAD_EAST);
+		graph->cells[second_node] &= ~CLOSED_WEST;
 
-		gsl_spmatrix_uint_set(graph->t, e[1].fr, e[1].to, EAST);
-		gsl_spmatrix_uint_set(graph->t, e[1].to, e[1].fr, WEST);
+		graph->cells[first_node + board_size] &= ~CLOSED_EAST;
+		graph->cells[second_node + board_size] &= ~CLOSED_WEST;
 	}
-	else if (gsl_spmatrix_uint_get(graph->t, e[0].fr, e[0].to) == 7
-		|| gsl_spmatrix_uint_get(graph->t, e[0].fr, e[0].to) == 8) {
-		gsl_spmatrix_uint_set(graph->t, e[0].fr, e[0].to, SOUTH);
-		gsl_spmatrix_uint_set(graph->t, e[0].to, e[0].fr, NORTH);
+	else if (first_node + board_size == second_node && (graph->cells[first_node] & WALL_HEAD_SOUTH)) {
+		// Horizontal wall
+		graph->cells[first_node] &= ~(CLOSED_SOUTH | WALL_HEAD_SOUTH);
+		graph->cells[second_node] &= ~CLOSED_NORTH;
 
-		gsl_spmatrix_uint_set(graph->t, e[1].fr, e[1].to, SOUTH);
-		gsl_spmatrix_uint_set(graph->t, e[1].to, e[1].fr, NORTH);
+		graph->cells[first_node + 1] &= ~CLOSED_SOUTH;
+		graph->cells[second_node + 1] &= ~CLOSED_NORTH;
 	}
-	else if (gsl_spmatrix_uint_get(graph->t, e[0].to, e[0].fr) == 5
-		|| gsl_spmatrix_uint_get(graph->t, e[0].to, e[0].fr) == 6) {
-		gsl_spmatrix_uint_set(graph->t, e[0].fr, e[0].to, WEST);
-		gsl_spmatrix_uint_set(graph->t, e[0].to, e[0].fr, EAST);
-
-		gsl_spmatrix_uint_set(graph->t, e[1].fr, e[1].to, WEST);
-		gsl_spmatrix_uint_set(graph->t, e[1].to, e[1].fr, EAST);
+	else {
+		printf("ERROR (%u) (%u)\n", edge_state(graph, e[0].fr, e[0].to),
+			edge_state(graph, e[0].to, e[0].fr));
+		return;
 	}
-	else if (gsl_spmatrix_uint_get(graph->t, e[0].to, e[0].fr) == 7
-		|| gsl_spmatrix_uint_get(graph->t, e[0].to, e[0].fr) == 8) {
-		gsl_spmatrix_uint_set(graph->t, e[0].fr, e[0].to, NORTH);
-		gsl_spmatrix_uint_set(graph->t, e[0].to, e[0].fr, SOUTH);
 
-		gsl_spmatrix_uint_set(graph->t, e[1].fr, e[1].to, NORTH);
-		gsl_spmatrix_uint_set(graph->t, e[1].to, e[1].fr, SOUTH);
-	}
-	else
-		printf("ERROR (%u) (%u)\n", gsl_spmatrix_uint_get(graph->t, e[0].fr, e[0].to),
-			gsl_spmatrix_uint_get(graph->t, e[0].to, e[0].fr));
+	size_t wall = first_node * 2 + (first_node + 1 == second_node);
+	wall_sets_removed(graph, wall);
+	wall_slots_remove(graph->wall_slots, wall);
+	graph->hash ^= zobrist_key(ZOBRIST_WALL, wall);
+
+	if (graph->fields != NULL)
+		fields_wall_removed(graph, wall);
 }
 
 /**
@@ -237,6 +460,61 @@ enum direction_t opposite(enum direction_t d) {
 	}
 }
 
+/**
+ * @brief Get the direction leading from src to dest
+ *
+ * @param graph The graph processed
+ * @param src The source vertex
+ * @param dest The destination vertex
+ *
+ * @return The direction of `dest` from `src`, NO_DIRECTION if they are not adjacent on the board
+ */
+enum direction_t direction_between(const struct graph_t* graph, size_t src, size_t dest) {
+	size_t m = graph->width;
+
+	if (src >= graph->num_vertices || dest >= graph->num_vertices)
+		return NO_DIRECTION;
+	if (dest + m == src)
+		return NORTH;
+	if (src + m == dest)
+		return SOUTH;
+	if (dest + 1 == src && src % m != 0)
+		return WEST;
+	if (src + 1 == dest && dest % m != 0)
+		return EAST;
+	return NO_DIRECTION;
+}
+
+/**
+ * @brief Get the state of the edge between src and dest
+ *
+ * @param graph The graph processed
+ * @param src The source vertex
+ * @param dest The destination vertex
+ *
+ * @return The direction of `dest` if the edge is open, the wall half closing it
+ * (see `enum edge_state_t`) if there is a wall, NO_EDGE_STATE if they are not adjacent
+ */
+unsigned edge_state(const struct graph_t* graph, size_t src, size_t dest) {
+	enum direction_t d = direction_between(graph, src, dest);
+
+	if (d == NO_DIRECTION)
+		return NO_EDGE_STATE;
+	if (!(graph->cells[src] & (1 << d)))
+		return d;
+
+	switch (d) {
+	case NORTH:
+		return graph->cells[dest] & WALL_HEAD_SOUTH ? HORIZONTAL_WALL_HEAD : HORIZONTAL_WALL_TAIL;
+	case SOUTH:
+		return graph->cells[src] & WALL_HEAD_SOUTH ? HORIZONTAL_WALL_HEAD : HORIZONTAL_WALL_TAIL;
+	case WEST:
+		return graph->cells[dest] & WALL_HEAD_EAST ? VERTICAL_WALL_HEAD : VERTICAL_WALL_TAIL;
+	default:
+		return graph->cells[src] & WALL_HEAD_EAST ? VERTICAL_WALL_HEAD : VERTICAL_WALL_TAIL;
+	}
+}
+
 /**
  * @brief Check if vertex src is linked to vertex dest (i.e there is an edge between them)
  *
@@ -245,7 +523,8 @@ enum direction_t opposite(enum direction_t d) {
  * @param dest The destination vertex
  */
 bool is_linked(const struct graph_t* graph, size_t src, size_t dest) {
-	return gsl_spmatrix_uint_get(graph->t, src, dest) > 0 && gsl_spmatrix_uint_get(graph->t, src, dest) < 5;
+	enum direction_t d = direction_between(graph, src, dest);
+	return d != NO_DIRECTION && !(graph->cells[src] & (1 << d));
 }
 
 /**
@@ -261,17 +540,19 @@ bool is_linked(const struct graph_t* graph, size_t src, size_t dest) {
  * @return The adjacent vertex of `v` in direction `d` vertex if it exists, if not returns no_vertex()
  */
 size_t vertex_from_direction(const struct graph_t* graph, size_t v, enum direction_t d) {
-	// TODO : this function can be optimised
-
-	if (v >= graph->num_vertices)
+	if (v >= graph->num_vertices || d <= NO_DIRECTION || d >= MAX_DIRECTION || (graph->cells[v] & (1 << d)))
 		return no_vertex();
 
-	for (size_t i = 0; i < graph->num_vertices; i++) {
-		if (gsl_spmatrix_uint_get(graph->t, v, i) == d)
-			return i;
+	switch (d) {
+	case NORTH:
+		return v - graph->width;
+	case SOUTH:
+		return v + graph->width;
+	case WEST:
+		return v - 1;
+	default:
+		return v + 1;
 	}
-
-	return no_vertex();
 }
 
 /**
@@ -285,14 +566,36 @@ size_t vertex_from_direction(const struct graph_t* graph, size_t v, enum directi
  * @param vertices An array of `size_t` of size at least `MAX_DIRECTION`
  */
 size_t get_linked(const struct graph_t* graph, size_t v, size_t vertices[]) {
-	size_t linked = 0;
+	size_t m = graph->width;
+	uint8_t closed = graph->cells[v];
+
 	vertices[NO_DIRECTION] = v; // First one is himself
+	vertices[NORTH] = closed & CLOSED_NORTH ? no_vertex() : v - m;
+	vertices[SOUTH] = closed & CLOSED_SOUTH ? no_vertex() : v + m;
+	vertices[WEST] = closed & CLOSED_WEST ? no_vertex() : v - 1;
+	vertices[EAST] = closed & CLOSED_EAST ? no_vertex() : v + 1;
 
-	for (enum direction_t i = NO_DIRECTION + 1; i < MAX_DIRECTION; i++) {
-		vertices[i] = vertex_from_direction(graph, v, i);
-		linked += !is_no_vertex(vertices[i]);
+	return 4 - __builtin_popcount(closed & (CLOSED_NORTH | CLOSED_SOUTH | CLOSED_WEST | CLOSED_EAST));
+}
+
+/**
+ * @brief Get all the linked vertices of a set of vertices
+ *
+ * @details Fill one row of `linked` per processed vertex, in the same way as get_linked()
+ *
+ * @param graph The graph processed
+ * @param vertices The vertices processed, or NULL to process the vertices from 0 to `count - 1`
+ * @param count The number of vertices processed
+ * @param linked An array of `count` rows of `MAX_DIRECTION` vertices
+ *
+ * @return The total number of edges found
+ */
+size_t get_linked_many(const struct graph_t* graph, const size_t vertices[], size_t count, size_t linked[][MAX_DIRECTION]) {
+	size_t total = 0;
+	for (size_t i = 0; i < count; i++) {
+		total += get_linked(graph, vertices == NULL ? i : vertices[i], linked[i]);
 	}
-	return linked;
+	return total;
 }
 
 /**
@@ -305,7 +608,7 @@ void display_adj_matrix(struct graph_t* board, size_t board_size) {
 	size_t nbCells = board_size * board_size;
 	for (size_t i = 0; i < nbCells; ++i) {
 		for (size_t j = 0; j < nbCells; ++j) {
-			printf("% d ", gsl_spmatrix_uint_get(board->t, i, j));
+			printf("% d ", edge_state(board, i, j));
 		}
 		printf("\n");
 	}
@@ -351,12 +654,12 @@ void display_board(struct graph_t* board, size_t board_size, size_t position_pla
 
 		unsigned int matrix_state_1 = 0;
 		if (i + 1 < board_size * board_size) {
-			matrix_state_1 = gsl_spmatrix_uint_get(board->t, i, i + 1);
+			matrix_state_1 = edge_state(board, i, i + 1);
 		}
 
 		unsigned int matrix_state_2 = 0;
 		if (i + board_size < board_size * board_size) {
-			matrix_state_2 = gsl_spmatrix_uint_get(board->t, i, i + board_size);
+			matrix_state_2 = edge_state(board, i, i + board_size);
 		}
 
 		// South connection
@@ -404,98 +707,968 @@ void display_board(struct graph_t* board, size_t board_size, size_t position_pla
 
 
 
-////////////////////////////// FOR DIJKSTRA ALGORITHM ////////////////////////////////
+//// Path searches
+
+/**
+ * @brief Run a breadth first search on the graph
+ *
+ * @details Every edge has a weight of 1, so vertices are processed by increasing distance
+ * and each one is enqueued at most once
+ *
+ * @param graph The graph processed
+ * @param queue A buffer of at least `graph->num_vertices` vertices, containing the `size` sources
+ * @param size The number of sources already in `queue`
+ * @param d The distances, set for the sources and IMPOSSIBLE_DISTANCE for the others
+ * @param stop A bitset of vertices ending the search when reached, NULL to visit the whole graph
+ *
+ * @return The distance of the first reached vertex in `stop`, IMPOSSIBLE_DISTANCE if there is none
+ */
+static size_t breadth_first_search(const struct graph_t* graph, size_t queue[], size_t size, size_t d[], const uint64_t* stop) {
+	size_t m = graph->width;
+
+	for (size_t head = 0; head < size; head++) {
+		size_t u = queue[head];
+		if (stop != NULL && (stop[u / 64] >> (u % 64)) & 1)
+			return d[u];
+
+		uint8_t closed = graph->cells[u];
+		size_t next = d[u] + 1;
+
+		if (!(closed & CLOSED_NORTH) && d[u - m] == IMPOSSIBLE_DISTANCE) {
+			d[u - m] = next;
+			queue[size++] = u - m;
+		}
+		if (!(closed & CLOSED_SOUTH) && d[u + m] == IMPOSSIBLE_DISTANCE) {
+			d[u + m] = next;
+			queue[size++] = u + m;
+		}
+		if (!(closed & CLOSED_WEST) && d[u - 1] == IMPOSSIBLE_DISTANCE) {
+			d[u - 1] = next;
+			queue[size++] = u - 1;
+		}
+		if (!(closed & CLOSED_EAST) && d[u + 1] == IMPOSSIBLE_DISTANCE) {
+			d[u + 1] = next;
+			queue[size++] = u + 1;
+		}
+	}
+	return IMPOSSIBLE_DISTANCE;
+}
+
 /**
- * @brief Init the array d of the distance and v of the vertices to be able to apply Dijkstra algorithm
- * @param d An array that will contain the distance of each vertex to the source. When the Dijkstra algorithm will be apllied, the distance between the source and the vertex i will be d[i]
- * @param v An array that will contain the vertices remaining to be traversed
- * @param length The number of vertices
+ * @brief Enqueue every vertex owned by a player as a source of a breadth first search
+ *
+ * @param graph The graph processed
+ * @param color The owner of the sources
+ * @param queue The search queue
+ * @param d The distances, where the sources are set to `distance`
+ * @param distance The distance given to the sources
+ *
+ * @return The number of sources
  */
-void dijkstra_init(size_t d[], size_t v[], size_t pos, size_t length){
-		for (size_t i = 0; i < length; i++) {
+static size_t enqueue_owned(const struct graph_t* graph, enum color_t color, size_t queue[], size_t d[], size_t distance) {
+	size_t size = 0;
+	size_t words = (graph->num_vertices + 63) / 64;
+
+	for (size_t w = 0; w < words; w++) {
+		for (uint64_t bits = graph->o[color][w]; bits; bits &= bits - 1) {
+			size_t v = w * 64 + __builtin_ctzll(bits);
+			d[v] = distance;
+			queue[size++] = v;
+		}
+	}
+	return size;
+}
+
+/**
+ * @brief Compute the distance to the arrival line of a player from every vertex
+ *
+ * @details Run a single breadth first search backwards from the vertices owned by the opponent,
+ * using the search buffer of the graph, so no memory is allocated
+ *
+ * @param graph The graph processed
+ * @param color The color of the player
+ * @param out An array of `graph->num_vertices` distances, IMPOSSIBLE_DISTANCE for the vertices
+ * that can not reach the arrival line
+ */
+void distance_field(struct graph_t* graph, enum color_t color, size_t out[]) {
+	for (size_t i = 0; i < graph->num_vertices; i++)
+		out[i] = IMPOSSIBLE_DISTANCE;
+
+	size_t size = enqueue_owned(graph, 1 - color, graph->scratch, out, 0);
+	breadth_first_search(graph, graph->scratch, size, out, NULL);
+}
+
+/**
+ * @brief Get the shortest distance between a position and the arrival line of a player
+ *
+ * @details The search stops as soon as the arrival line is reached. If the player is not
+ * on the board yet, the distance is computed from its starting line, counting the first move. \n
+ * The search buffers of the graph are used, so no memory is allocated
+ *
+ * @param graph The graph processed
+ * @param pos The position of the player
+ * @param color The color of the player
+ *
+ * @returns The distance between the position pos and the target line for the right player,
+ * IMPOSSIBLE_DISTANCE if it can not be reached
+ */
+size_t dijkstra(struct graph_t *graph, size_t pos, enum color_t color){
+	size_t* d = graph->distances;
+	for (size_t i = 0; i < graph->num_vertices; i++)
 		d[i] = IMPOSSIBLE_DISTANCE;
-		v[i] = i;
-	}
-	d[pos] = 0;
-	
-}
-
-/**
- * @brief Used to know what vertex is the next to be release the Dijkstra algorithm context. This vextex is removed from the array v : it is replaced by the last element of v and the size of v decreases by one. 
- * @param d The array containing the distances between vertices and the source.
- * @param v The array containing the remaining vertex
- * @param length The number of remaining params
- * @returns The index of a vertex
- */ 
-size_t extract_min(size_t d[], size_t v[],size_t length){
-	size_t ind = length+1;
-	size_t min = length*4;
-	for(size_t i = 0; i < length; i++)
-		if(d[v[i]] < min){
-			min = d[v[i]];
-			ind = i;
+
+	size_t size = 1;
+	if (pos < graph->num_vertices) {
+		d[pos] = 0;
+		graph->scratch[0] = pos;
+	}
+	else {
+		size = enqueue_owned(graph, color, graph->scratch, d, 1);
+	}
+	return breadth_first_search(graph, graph->scratch, size, d, graph->o[1 - color]);
+}
+
+
+//// Incremental distance fields
+
+/** @enum State of a vertex during the repair of a distance field */
+enum repair_state_t {
+	VALID = 0, 		/**< The distance of the vertex is correct */
+	INVALID = 1, 	/**< The vertex lost all its shortest paths */
+	REPAIRED = 2 	/**< The new distance of the vertex is final */
+};
+
+/** Distance of the vertices waiting to be repaired */
+#define UNKNOWN_DISTANCE SIZE_MAX
+
+/**
+ * @brief Enable the distance fields of a graph
+ *
+ * @details Once enabled, the distance to the arrival line of both players is known for every vertex,
+ * and place_wall() and remove_wall() keep it up to date \n
+ * Does nothing if the fields are already enabled
+ *
+ * @param graph The graph processed
+ */
+void enable_distance_fields(struct graph_t* graph) {
+	if (graph->fields != NULL)
+		return;
+
+	size_t n = graph->num_vertices;
+	struct distance_fields_t* f = malloc(sizeof(*f));
+
+	f->d[BLACK] = malloc(2 * n * sizeof(size_t));
+	f->d[WHITE] = f->d[BLACK] + n;
+	f->log_size = 0;
+	f->log_capacity = 64;
+	f->log = malloc(f->log_capacity * sizeof(size_t));
+	f->num_marks = 0;
+	f->marks_capacity = 16;
+	f->marks = malloc(f->marks_capacity * sizeof(struct wall_mark_t));
+	f->work = malloc((7 * n + 4) * sizeof(size_t));
+	f->state = calloc(n, sizeof(uint8_t));
+
+	distance_field(graph, BLACK, f->d[BLACK]);
+	distance_field(graph, WHITE, f->d[WHITE]);
+	graph->fields = f;
+}
+
+/**
+ * @brief Get a maintained distance field
+ *
+ * @param graph The graph processed
+ * @param color The color of the player
+ *
+ * @return The distance to the arrival line of the player from every vertex,
+ * NULL if the distance fields are not enabled
+ */
+const size_t* get_distance_field(const struct graph_t* graph, enum color_t color) {
+	return graph->fields == NULL ? NULL : graph->fields->d[color];
+}
+
+/**
+ * @brief Get the shortest distance between a position and the arrival line of a player
+ *
+ * @details Read the maintained distance field if it is enabled, else run a search
+ *
+ * @param graph The graph processed
+ * @param pos The position of the player
+ * @param color The color of the player
+ *
+ * @return The distance to the arrival line, IMPOSSIBLE_DISTANCE if it can not be reached
+ */
+size_t goal_distance(struct graph_t* graph, size_t pos, enum color_t color) {
+	if (graph->fields != NULL && pos < graph->num_vertices)
+		return graph->fields->d[color][pos];
+	return dijkstra(graph, pos, color);
+}
+
+/**
+ * @brief Save the previous distance of a vertex in the undo log
+ */
+static void log_distance(struct distance_fields_t* f, size_t index, size_t distance) {
+	if (f->log_size + 2 > f->log_capacity) {
+		f->log_capacity *= 2;
+		f->log = realloc(f->log, f->log_capacity * sizeof(size_t));
+	}
+	f->log[f->log_size++] = index;
+	f->log[f->log_size++] = distance;
+}
+
+/**
+ * @brief Compare two sizes for qsort
+ */
+static int compare_sizes(const void* a, const void* b) {
+	size_t x = *(const size_t*)a;
+	size_t y = *(const size_t*)b;
+	return (x > y) - (x < y);
+}
+
+/**
+ * @brief Repair a distance field after some edges have been removed
+ *
+ * @details Distances can only grow when edges are removed. First, the vertices that lost all
+ * their neighbours one step closer to the arrival line are invalidated, along with the vertices
+ * that depended on them. Then the invalidated region is filled again by a breadth first search
+ * seeded from its valid border, in increasing distance order. \n
+ * The previous distance of every changed vertex is saved in the undo log
+ *
+ * @param graph The graph processed, without the removed edges
+ * @param color The color of the player whose field is repaired
+ * @param ends The vertices of the removed edges, two by two
+ * @param num_ends The number of vertices in `ends`
+ */
+static void repair_field(struct graph_t* graph, enum color_t color, const size_t ends[], size_t num_ends) {
+	struct distance_fields_t* f = graph->fields;
+	size_t* d = f->d[color];
+	size_t n = graph->num_vertices;
+
+	size_t* stack = f->work;
+	size_t* invalid = stack + 4 * n + 4;
+	size_t* seeds = invalid + n;
+	size_t* queue = seeds + n;
+	size_t top = 0;
+	size_t num_invalid = 0;
+
+	// The endpoint further from the arrival line may have lost its shortest path
+	for (size_t i = 0; i + 1 < num_ends; i += 2) {
+		size_t u = ends[i];
+		size_t v = ends[i + 1];
+		if (d[u] != IMPOSSIBLE_DISTANCE && d[u] == d[v] + 1)
+			stack[top++] = u;
+		if (d[v] != IMPOSSIBLE_DISTANCE && d[v] == d[u] + 1)
+			stack[top++] = v;
+	}
+
+	// Invalidate the vertices without any remaining shortest path
+	while (top > 0) {
+		size_t x = stack[--top];
+		size_t dx = d[x];
+		if (f->state[x] != VALID || dx == 0)
+			continue;
+
+		size_t linked[MAX_DIRECTION];
+		get_linked(graph, x, linked);
+
+		bool supported = false;
+		for (enum direction_t dir = NORTH; dir < MAX_DIRECTION && !supported; dir++)
+			supported = !is_no_vertex(linked[dir]) && d[linked[dir]] + 1 == dx;
+		if (supported)
+			continue;
+
+		f->state[x] = INVALID;
+		log_distance(f, color * n + x, dx);
+		d[x] = UNKNOWN_DISTANCE;
+		invalid[num_invalid++] = x;
+
+		for (enum direction_t dir = NORTH; dir < MAX_DIRECTION; dir++)
+			if (!is_no_vertex(linked[dir]) && d[linked[dir]] == dx + 1)
+				stack[top++] = linked[dir];
+	}
+
+	// Give each invalid vertex its best distance through the valid vertices
+	size_t num_seeds = 0;
+	for (size_t i = 0; i < num_invalid; i++) {
+		size_t x = invalid[i];
+		size_t linked[MAX_DIRECTION];
+		get_linked(graph, x, linked);
+
+		d[x] = IMPOSSIBLE_DISTANCE;
+		for (enum direction_t dir = NORTH; dir < MAX_DIRECTION; dir++) {
+			size_t y = linked[dir];
+			if (!is_no_vertex(y) && f->state[y] == VALID && d[y] != IMPOSSIBLE_DISTANCE && d[y] + 1 < d[x])
+				d[x] = d[y] + 1;
+		}
+
+		// Sort keys hold the distance and the vertex
+		if (d[x] != IMPOSSIBLE_DISTANCE)
+			seeds[num_seeds++] = d[x] * n + x;
+	}
+	qsort(seeds, num_seeds, sizeof(size_t), compare_sizes);
+
+	// Breadth first search in the invalid region, merging the seeds by increasing distance
+	size_t head = 0;
+	size_t tail = 0;
+	size_t next_seed = 0;
+	while (next_seed < num_seeds || head < tail) {
+		size_t x;
+		if (head < tail && (next_seed == num_seeds || d[queue[head]] <= seeds[next_seed] / n)) {
+			x = queue[head++];
+		}
+		else {
+			x = seeds[next_seed++] % n;
 		}
-	size_t vertex = v[ind];
-	v[ind] = v[length - 1];
-	return vertex;
+		if (f->state[x] == REPAIRED)
+			continue;
+		f->state[x] = REPAIRED;
+
+		size_t linked[MAX_DIRECTION];
+		get_linked(graph, x, linked);
+		for (enum direction_t dir = NORTH; dir < MAX_DIRECTION; dir++) {
+			size_t z = linked[dir];
+			if (!is_no_vertex(z) && f->state[z] == INVALID && d[x] + 1 < d[z]) {
+				d[z] = d[x] + 1;
+				queue[tail++] = z;
+			}
+		}
+	}
+
+	for (size_t i = 0; i < num_invalid; i++)
+		f->state[invalid[i]] = VALID;
 }
 
 /**
- * @brief Used to know if an element is in an array
- * 
+ * @brief Update the distance fields after a wall has been placed
  *
- */ 
-bool belong(size_t elem, size_t arr[], size_t length){
-	for (size_t i = 0; i < length; i++)
-		if (elem == arr[i])
-			return true;
-	return false;
+ * @param graph The graph processed, with the wall
+ * @param wall The identifier of the wall, see `struct wall_mark_t`
+ * @param ends The vertices of the two edges closed by the wall
+ */
+static void fields_wall_placed(struct graph_t* graph, size_t wall, const size_t ends[4]) {
+	struct distance_fields_t* f = graph->fields;
+
+	if (f->num_marks == f->marks_capacity) {
+		f->marks_capacity *= 2;
+		f->marks = realloc(f->marks, f->marks_capacity * sizeof(struct wall_mark_t));
+	}
+	f->marks[f->num_marks++] = (struct wall_mark_t){ .wall = wall, .log_size = f->log_size };
+
+	repair_field(graph, BLACK, ends, 4);
+	repair_field(graph, WHITE, ends, 4);
 }
 
 /**
- * @brief Release the edge between vertex u and vertex v in the Dijkstra algorithm context
- * @param d The array that contains the distances
+ * @brief Update the distance fields after a wall has been removed
  *
- */ 
+ * @details If the wall is the last one placed, the previous distances are restored from the log.
+ * Otherwise the log does not match the board anymore, so it is dropped and the fields are
+ * computed again
+ *
+ * @param graph The graph processed, without the wall
+ * @param wall The identifier of the wall, see `struct wall_mark_t`
+ */
+static void fields_wall_removed(struct graph_t* graph, size_t wall) {
+	struct distance_fields_t* f = graph->fields;
+	size_t n = graph->num_vertices;
 
-void release_dijk(size_t u, size_t v, size_t d[]){
-	if (d[v] > d[u] + 1)
-		d[v] = d[u] + 1;
+	if (f->num_marks > 0 && f->marks[f->num_marks - 1].wall == wall) {
+		size_t log_size = f->marks[--f->num_marks].log_size;
+		while (f->log_size > log_size) {
+			size_t distance = f->log[--f->log_size];
+			size_t index = f->log[--f->log_size];
+			f->d[index / n][index % n] = distance;
+		}
+		return;
+	}
+
+	f->num_marks = 0;
+	f->log_size = 0;
+	distance_field(graph, BLACK, f->d[BLACK]);
+	distance_field(graph, WHITE, f->d[WHITE]);
 }
 
 
+//// Wall connectivity
+
 /**
- * @brief Get the shortest distance between the source and a vertex among the target line vertices
- * @param color The color of the player that we want to know his distance to reach to the arrival line.
+ * @brief Get the lattice points covered by a wall
  *
- */ 
-//Returns the shortest distance in array d under condition that the vertes is a target vertex.
-size_t get_shortest(size_t d[], struct graph_t *graph, enum color_t color){
-	size_t min = IMPOSSIBLE_DISTANCE;
-	for (size_t i = 0; i < graph->num_vertices; i++)
-		if (d[i] < min && gsl_spmatrix_uint_get(graph->o, 1 - color, i)){
-			min = d[i];
+ * @details Lattice points are the corners of the vertices, there are (m + 1) * (m + 1) of them.
+ * Every point of the border is represented by the last point of the sets
+ *
+ * @param sets The wall sets
+ * @param m The size of the board
+ * @param wall The identifier of the wall, see `struct wall_mark_t`
+ * @param points An array filled with the three points covered by the wall
+ */
+static void wall_points(const struct wall_sets_t* sets, size_t m, size_t wall, size_t points[3]) {
+	size_t head = wall / 2;
+	size_t row = head / m;
+	size_t column = head % m;
+
+	for (size_t k = 0; k < 3; k++) {
+		// A vertical wall goes down between two columns, an horizontal one goes right between two rows
+		size_t r = wall % 2 ? row + k : row + 1;
+		size_t c = wall % 2 ? column + 1 : column + k;
+		bool border = r == 0 || r == m || c == 0 || c == m;
+		points[k] = border ? sets->num_points - 1 : r * (m + 1) + c;
+	}
+}
+
+/**
+ * @brief Find the root of the set of a lattice point
+ *
+ * @details There is no path compression, so that unions can be rolled back
+ */
+static size_t find_set(const struct wall_sets_t* sets, size_t point) {
+	while (sets->parent[point] != point)
+		point = sets->parent[point];
+	return point;
+}
+
+/**
+ * @brief Merge the sets of two lattice points, by rank
+ */
+static void union_sets(struct wall_sets_t* sets, size_t a, size_t b) {
+	a = find_set(sets, a);
+	b = find_set(sets, b);
+	if (a == b)
+		return;
+
+	if (sets->rank[a] < sets->rank[b]) {
+		size_t tmp = a;
+		a = b;
+		b = tmp;
+	}
+
+	bool grew = sets->rank[a] == sets->rank[b];
+	sets->parent[b] = a;
+	sets->rank[a] += grew;
+	sets->history[sets->history_size++] = b * 2 + grew;
+}
+
+/**
+ * @brief Join a wall to the sets of the points it covers
+ */
+static void join_wall(struct graph_t* graph, size_t wall) {
+	size_t points[3];
+	wall_points(graph->wall_sets, graph->width, wall, points);
+	union_sets(graph->wall_sets, points[0], points[1]);
+	union_sets(graph->wall_sets, points[1], points[2]);
+}
+
+/**
+ * @brief Build the wall sets from the walls of the graph
+ *
+ * @details The unions done here can not be rolled back
+ *
+ * @param graph The graph processed
+ */
+static void wall_sets_rebuild(struct graph_t* graph) {
+	struct wall_sets_t* sets = graph->wall_sets;
+
+	for (size_t p = 0; p < sets->num_points; p++) {
+		sets->parent[p] = p;
+		sets->rank[p] = 0;
+	}
+	sets->history_size = 0;
+	sets->num_marks = 0;
+
+	for (size_t v = 0; v < graph->num_vertices; v++) {
+		if (graph->cells[v] & WALL_HEAD_EAST)
+			join_wall(graph, v * 2 + 1);
+		if (graph->cells[v] & WALL_HEAD_SOUTH)
+			join_wall(graph, v * 2);
+	}
+	sets->history_size = 0;
+}
+
+/**
+ * @brief Update the wall sets after a wall has been placed
+ *
+ * @param graph The graph processed
+ * @param wall The identifier of the wall, see `struct wall_mark_t`
+ */
+static void wall_sets_placed(struct graph_t* graph, size_t wall) {
+	struct wall_sets_t* sets = graph->wall_sets;
+
+	if (sets->num_marks == sets->marks_capacity) {
+		sets->marks_capacity *= 2;
+		sets->marks = realloc(sets->marks, sets->marks_capacity * sizeof(*sets->marks));
+	}
+	sets->marks[sets->num_marks++] = (struct wall_mark_t){ .wall = wall, .log_size = sets->history_size };
+
+	join_wall(graph, wall);
+}
+
+/**
+ * @brief Update the wall sets after a wall has been removed
+ *
+ * @details If the wall is the last one placed, its unions are rolled back,
+ * else the sets are built again
+ *
+ * @param graph The graph processed, without the wall
+ * @param wall The identifier of the wall, see `struct wall_mark_t`
+ */
+static void wall_sets_removed(struct graph_t* graph, size_t wall) {
+	struct wall_sets_t* sets = graph->wall_sets;
+
+	if (sets->num_marks == 0 || sets->marks[sets->num_marks - 1].wall != wall) {
+		wall_sets_rebuild(graph);
+		return;
+	}
+
+	size_t history_size = sets->marks[--sets->num_marks].log_size;
+	while (sets->history_size > history_size) {
+		size_t entry = sets->history[--sets->history_size];
+		size_t b = entry / 2;
+		size_t a = sets->parent[b];
+		sets->parent[b] = b;
+		sets->rank[a] -= entry % 2;
+	}
+}
+
+/**
+ * @brief Check if a wall may prevent a player from reaching its arrival line
+ *
+ * @details A wall can only cut the board in two if it closes a loop of walls, i.e. if two
+ * of the three lattice points it covers are already connected by walls or by the border.
+ * If this function returns false, the wall can not disconnect anything and no path check is needed
+ *
+ * @param graph The graph processed
+ * @param e An array of two edges representing a wall, not placed on the graph
+ *
+ * @return True if the wall closes a loop, else false
+ */
+bool wall_may_disconnect(const struct graph_t* graph, const struct edge_t e[2]) {
+	struct edge_t sorted[2] = { e[0], e[1] };
+	sort_edges(sorted);
+
+	size_t points[3];
+	wall_points(graph->wall_sets, graph->width, sorted[0].fr * 2 + (sorted[0].fr + 1 == sorted[0].to), points);
+
+	size_t a = find_set(graph->wall_sets, points[0]);
+	size_t b = find_set(graph->wall_sets, points[1]);
+	size_t c = find_set(graph->wall_sets, points[2]);
+	return a == b || a == c || b == c;
+}
+
+
+//// Wall emplacements
+
+/**
+ * @brief Allocate the wall emplacements of an empty square board
+ *
+ * @details The walls conflicting with each wall are computed once here: the wall itself,
+ * the wall crossing it and the two walls of the same orientation overlapping it
+ *
+ * @param m The size of the board
+ *
+ * @return The wall emplacements, all free
+ */
+struct wall_slots_t* wall_slots_alloc(size_t m) {
+	struct wall_slots_t* slots = malloc(sizeof(*slots));
+	size_t n = m * m;
+
+	slots->width = m;
+	slots->words = (n + 63) / 64;
+	slots->free[HORIZONTAL] = malloc(2 * slots->words * sizeof(uint64_t));
+	slots->free[VERTICAL] = slots->free[HORIZONTAL] + slots->words;
+	slots->blockers = malloc(2 * n * sizeof(*slots->blockers));
+	slots->conflicts = malloc(2 * n * sizeof(*slots->conflicts));
+
+	for (size_t head = 0; head < n; head++) {
+		size_t row = head / m;
+		size_t column = head % m;
+		bool valid = row < m - 1 && column < m - 1;
+
+		for (enum orientation_t o = HORIZONTAL; o <= VERTICAL; o++) {
+			uint32_t* conflicts = slots->conflicts[head * 2 + o];
+			for (size_t k = 0; k < 4; k++)
+				conflicts[k] = UINT32_MAX;
+			if (!valid)
+				continue;
+
+			conflicts[0] = head * 2 + o;
+			conflicts[1] = head * 2 + !o;
+			if (o == HORIZONTAL) {
+				if (column > 0)
+					conflicts[2] = (head - 1) * 2 + o;
+				if (column + 2 < m)
+					conflicts[3] = (head + 1) * 2 + o;
+			}
+			else {
+				if (row > 0)
+					conflicts[2] = (head - m) * 2 + o;
+				if (row + 2 < m)
+					conflicts[3] = (head + m) * 2 + o;
+			}
+		}
+	}
+
+	wall_slots_reset(slots);
+	return slots;
+}
+
+/**
+ * @brief Free every wall emplacement, as on an empty board
+ *
+ * @param slots The wall emplacements
+ */
+void wall_slots_reset(struct wall_slots_t* slots) {
+	size_t m = slots->width;
+
+	memset(slots->free[HORIZONTAL], 0, 2 * slots->words * sizeof(uint64_t));
+	memset(slots->blockers, 0, 2 * m * m * sizeof(*slots->blockers));
+	for (size_t head = 0; head < m * m; head++) {
+		if (head / m < m - 1 && head % m < m - 1) {
+			slots->free[HORIZONTAL][head / 64] |= (uint64_t)1 << (head % 64);
+			slots->free[VERTICAL][head / 64] |= (uint64_t)1 << (head % 64);
 		}
-	return min;
+	}
 }
+
 /**
- * @brief Dijkstra algorithm to get the closest path
- * @returns The distance between the position pos and the target line for the right player using the Dijkstra algorithm
- * 
+ * @brief Free the memory allocated for wall emplacements
+ *
+ * @param slots The wall emplacements to free
  */
-size_t dijkstra(struct graph_t *graph, size_t pos, enum color_t color){
-	size_t nb_v = graph->num_vertices;
-	size_t d[nb_v];
-	size_t v[nb_v];
-	dijkstra_init(d, v, pos, nb_v);
-	while (nb_v){
-		size_t u = extract_min(d, v, nb_v);
-		nb_v--;
-		size_t succ[MAX_DIRECTION];
-		get_linked(graph, u, succ);
-		for (size_t i = 0; i < MAX_DIRECTION; i++)
-			if (belong(succ[i], v, nb_v))
-				release_dijk(u, succ[i], d);
-	}
-	return get_shortest(d, graph, color);
+void wall_slots_free(struct wall_slots_t* slots) {
+	free(slots->free[HORIZONTAL]);
+	free(slots->blockers);
+	free(slots->conflicts);
+	free(slots);
+}
+
+/**
+ * @brief Copy wall emplacements of the same size
+ *
+ * @param dest The wall emplacements overwritten
+ * @param src The wall emplacements copied
+ */
+void wall_slots_copy(struct wall_slots_t* dest, const struct wall_slots_t* src) {
+	memcpy(dest->free[HORIZONTAL], src->free[HORIZONTAL], 2 * src->words * sizeof(uint64_t));
+	memcpy(dest->blockers, src->blockers, 2 * src->width * src->width * sizeof(*src->blockers));
+}
+
+/**
+ * @brief Mark the emplacements blocked by a placed wall
+ *
+ * @param slots The wall emplacements
+ * @param wall The identifier of the wall, see `struct wall_mark_t`
+ */
+void wall_slots_place(struct wall_slots_t* slots, size_t wall) {
+	for (size_t k = 0; k < 4; k++) {
+		uint32_t c = slots->conflicts[wall][k];
+		if (c != UINT32_MAX && slots->blockers[c]++ == 0)
+			slots->free[c % 2][c / 2 / 64] &= ~((uint64_t)1 << (c / 2 % 64));
+	}
+}
+
+/**
+ * @brief Release the emplacements blocked by a removed wall
+ *
+ * @details An emplacement is free again once no placed wall blocks it
+ *
+ * @param slots The wall emplacements
+ * @param wall The identifier of the wall, see `struct wall_mark_t`
+ */
+void wall_slots_remove(struct wall_slots_t* slots, size_t wall) {
+	for (size_t k = 0; k < 4; k++) {
+		uint32_t c = slots->conflicts[wall][k];
+		if (c != UINT32_MAX && --slots->blockers[c] == 0)
+			slots->free[c % 2][c / 2 / 64] |= (uint64_t)1 << (c / 2 % 64);
+	}
+}
+
+/**
+ * @brief Get the number of free wall emplacements
+ *
+ * @param slots The wall emplacements
+ *
+ * @return The number of walls that can be placed, both orientations included
+ */
+size_t wall_slots_count(const struct wall_slots_t* slots) {
+	size_t count = 0;
+	for (size_t i = 0; i < 2 * slots->words; i++)
+		count += __builtin_popcountll(slots->free[HORIZONTAL][i]);
+	return count;
+}
+
+/**
+ * @brief Get the edges of a wall from its identifier
+ *
+ * @param m The size of the board
+ * @param wall The identifier of the wall, see `struct wall_mark_t`
+ * @param e An array filled with the two edges of the wall, head first
+ */
+void wall_edges(size_t m, size_t wall, struct edge_t e[2]) {
+	size_t head = wall / 2;
+	size_t shift = wall % 2 ? m : 1;
+	size_t cut = wall % 2 ? 1 : m;
+
+	e[0] = (struct edge_t){ head, head + cut };
+	e[1] = (struct edge_t){ head + shift, head + shift + cut };
+}
+
+
+
+//// Wall candidates
+
+/**
+ * @brief Mark the edges on the shortest paths between a position and the arrival line of a player
+ *
+ * @details An edge (u, v) is on a shortest path if the distance from the position to u, plus one,
+ * plus the distance from v to the arrival line is the length of the shortest path. Both ends of
+ * an edge are marked, so a wall closes a marked edge if one of its vertices has the direction of
+ * the wall marked. A wall closing no marked edge can not change the distance of the player. \n
+ * The distances are kept in the search buffers of the graph
+ *
+ * @param graph The graph processed
+ * @param pos The position of the player, no_vertex() if it is not on the board yet
+ * @param color The color of the player
+ * @param marks An array of `graph->num_vertices` flags, where (1 << d) is added to the vertices
+ * having an edge on a shortest path in direction d, and ON_SHORTEST_PATH to the vertices of the paths
+ */
+void mark_shortest_paths(struct graph_t* graph, size_t pos, enum color_t color, uint8_t marks[]) {
+	size_t n = graph->num_vertices;
+
+	const size_t* to = get_distance_field(graph, color);
+	size_t* from = graph->distances;
+	if (to == NULL) {
+		distance_field(graph, color, from + n);
+		to = from + n;
+	}
+
+	for (size_t i = 0; i < n; i++)
+		from[i] = IMPOSSIBLE_DISTANCE;
+
+	size_t size = 1;
+	if (pos < n) {
+		from[pos] = 0;
+		graph->scratch[0] = pos;
+	}
+	else {
+		size = enqueue_owned(graph, color, graph->scratch, from, 0);
+	}
+	breadth_first_search(graph, graph->scratch, size, from, NULL);
+
+	size_t length = IMPOSSIBLE_DISTANCE;
+	for (size_t i = 0; i < size; i++)
+		if (to[graph->scratch[i]] < length)
+			length = to[graph->scratch[i]];
+	if (length == IMPOSSIBLE_DISTANCE)
+		return;
+
+	for (size_t u = 0; u < n; u++) {
+		if (from[u] + to[u] != length)
+			continue;
+
+		marks[u] |= ON_SHORTEST_PATH;
+		for (enum direction_t d = NORTH; d <= EAST; d++) {
+			if (graph->cells[u] & (1 << d))
+				continue;
+			size_t v = vertex_from_direction(graph, u, d);
+			if (from[v] == from[u] + 1 && to[v] + 1 == to[u]) {
+				marks[u] |= 1 << d;
+				marks[v] |= 1 << opposite(d);
+			}
+		}
+	}
+}
+
+/**
+ * @brief Get the free walls closing an edge marked by mark_shortest_paths(), and a few others
+ *
+ * @details The other walls are the free walls having a marked vertex among their four vertices,
+ * taken in the order of their identifiers until `num_others` of them are found. \n
+ * The walls are returned by increasing identifier
+ *
+ * @param graph The graph processed
+ * @param marks The marks of the shortest paths, of one or both players
+ * @param num_others The maximum number of walls closing no marked edge
+ * @param walls An array of at least wall_slots_count() identifiers, filled with the candidates
+ *
+ * @return The number of candidates
+ */
+size_t wall_candidates(const struct graph_t* graph, const uint8_t marks[], size_t num_others, size_t walls[]) {
+	const struct wall_slots_t* slots = graph->wall_slots;
+	size_t m = graph->width;
+	size_t count = 0;
+
+	for (size_t w = 0; w < slots->words; w++) {
+		for (uint64_t bits = slots->free[HORIZONTAL][w] | slots->free[VERTICAL][w]; bits; bits &= bits - 1) {
+			size_t a = w * 64 + __builtin_ctzll(bits);
+			uint8_t around = marks[a] | marks[a + 1] | marks[a + m] | marks[a + m + 1];
+
+			for (enum orientation_t o = HORIZONTAL; o <= VERTICAL; o++) {
+				if (!((slots->free[o][w] >> (a % 64)) & 1))
+					continue;
+
+				bool closes = o == HORIZONTAL
+					? ((marks[a] | marks[a + 1]) & CLOSED_SOUTH) != 0
+					: ((marks[a] | marks[a + m]) & CLOSED_EAST) != 0;
+				if (closes)
+					walls[count++] = a * 2 + o;
+				else if (num_others > 0 && (around & ON_SHORTEST_PATH)) {
+					walls[count++] = a * 2 + o;
+					num_others--;
+				}
+			}
+		}
+	}
+	return count;
+}
+
+//// Pawn moves
+
+
+/**
+ * @brief Fill the table of the legal pawn moves
+ *
+ * @details A pawn can step in any open direction, except onto the opponent.
+ * If the opponent is adjacent through an open edge, the pawn can jump over it
+ * in the same direction, or beside it in the two perpendicular directions,
+ * as long as the edge leaving the opponent is open
+ */
+static void pawn_table_init(void) {
+	static const enum pawn_move_t diagonal[MAX_DIRECTION][MAX_DIRECTION] = {
+		[NORTH] = { [WEST] = JUMP_NORTH_WEST, [EAST] = JUMP_NORTH_EAST },
+		[SOUTH] = { [WEST] = JUMP_SOUTH_WEST, [EAST] = JUMP_SOUTH_EAST },
+		[WEST] = { [NORTH] = JUMP_NORTH_WEST, [SOUTH] = JUMP_SOUTH_WEST },
+		[EAST] = { [NORTH] = JUMP_NORTH_EAST, [SOUTH] = JUMP_SOUTH_EAST },
+	};
+
+	for (enum direction_t o = NO_DIRECTION; o < MAX_DIRECTION; o++) {
+		for (uint8_t self = 0; self < 16; self++) {
+			for (uint8_t opponent = 0; opponent < 16; opponent++) {
+				uint16_t moves = 0;
+				for (enum direction_t d = NORTH; d < MAX_DIRECTION; d++) {
+					bool open = !((self << 1) & (1 << d));
+					if (open && d != o)
+						moves |= 1 << (STEP_NORTH + d - NORTH);
+				}
+
+				if (o != NO_DIRECTION && !((self << 1) & (1 << o))) {
+					for (enum direction_t d = NORTH; d < MAX_DIRECTION; d++) {
+						if (d == opposite(o) || ((opponent << 1) & (1 << d)))
+							continue;
+						moves |= 1 << (d == o ? JUMP_NORTH + d - NORTH : diagonal[o][d]);
+					}
+				}
+				pawn_table[o][self][opponent] = moves;
+			}
+		}
+	}
+	pawn_table_ready = true;
+}
+
+/**
+ * @brief Get the legal pawn moves from the closed directions around the pawn and the opponent
+ *
+ * @param self_cell The flags of the vertex of the pawn, see `enum cell_flag_t`
+ * @param opponent_cell The flags of the vertex of the opponent
+ * @param opponent_direction The direction of the opponent, NO_DIRECTION if it is not adjacent
+ *
+ * @return A mask with bit (1 << move) set for each legal `enum pawn_move_t`
+ */
+uint16_t pawn_moves_lookup(uint8_t self_cell, uint8_t opponent_cell, enum direction_t opponent_direction) {
+	if (!pawn_table_ready)
+		pawn_table_init();
+	return pawn_table[opponent_direction][(self_cell >> 1) & 0xF][(opponent_cell >> 1) & 0xF];
+}
+
+/**
+ * @brief Get the legal pawn moves of a player standing on pos
+ *
+ * @param graph The graph processed
+ * @param pos The vertex of the pawn, on the board
+ * @param opponent The vertex of the opponent, or no_vertex() if it is not on the board
+ *
+ * @return A mask with bit (1 << move) set for each legal `enum pawn_move_t`
+ */
+uint16_t pawn_moves(const struct graph_t* graph, size_t pos, size_t opponent) {
+	enum direction_t d = direction_between(graph, pos, opponent);
+	return pawn_moves_lookup(graph->cells[pos], d == NO_DIRECTION ? 0 : graph->cells[opponent], d);
+}
+
+/**
+ * @brief Get the offset between a pawn and the destination of a move
+ *
+ * @param m The size of the board
+ * @param move The move
+ *
+ * @return The index of the destination minus the index of the pawn
+ */
+long pawn_move_offset(size_t m, enum pawn_move_t move) {
+	long w = (long)m;
+	const long offsets[MAX_PAWN_MOVE] = {
+		-w, w, -1, 1,
+		-2 * w, 2 * w, -2, 2,
+		-w - 1, -w + 1, w - 1, w + 1
+	};
+	return offsets[move];
+}
+
+/**
+ * @brief Get the destinations of the legal pawn moves of a player standing on pos
+ *
+ * @param graph The graph processed
+ * @param pos The vertex of the pawn, on the board
+ * @param opponent The vertex of the opponent, or no_vertex() if it is not on the board
+ * @param destinations An array filled with the destination of each move, or no_vertex() if it is not legal
+ *
+ * @return The number of legal moves
+ */
+size_t get_pawn_moves(const struct graph_t* graph, size_t pos, size_t opponent, size_t destinations[MAX_PAWN_MOVE]) {
+	uint16_t moves = pawn_moves(graph, pos, opponent);
+	for (enum pawn_move_t k = STEP_NORTH; k < MAX_PAWN_MOVE; k++)
+		destinations[k] = (moves >> k) & 1 ? pos + pawn_move_offset(graph->width, k) : no_vertex();
+	return __builtin_popcount(moves);
+}
+
+/**
+ * @brief Check if a player standing on pos can move to the destination
+ *
+ * @param graph The graph processed
+ * @param pos The vertex of the pawn, on the board
+ * @param opponent The vertex of the opponent, or no_vertex() if it is not on the board
+ * @param destination The vertex reached by the move
+ *
+ * @return True if the move is legal, else false
+ */
+bool is_pawn_move(const struct graph_t* graph, size_t pos, size_t opponent, size_t destination) {
+	uint16_t moves = pawn_moves(graph, pos, opponent);
+	while (moves) {
+		enum pawn_move_t k = __builtin_ctz(moves);
+		moves &= moves - 1;
+		if (pos + pawn_move_offset(graph->width, k) == destination)
+			return true;
+	}
+	return false;
+}
+
+
+//// Position hashing
+
+/**
+ * @brief Compute the hash of a position from scratch
+ *
+ * @details The hash is the xor of the keys of the placed walls, of the pawns,
+ * of the walls left to each player and of the player to move.
+ * It can be updated incrementally by xoring the keys that change with a move,
+ * place_wall() and remove_wall() already do it for the walls
+ *
+ * @param graph The graph processed
+ * @param pos The vertex of each pawn, or no_vertex() if it is not on the board
+ * @param num_walls The number of walls left to each player
+ * @param to_move The next player to move
+ *
+ * @return The 64 bits hash of the position
+ */
+uint64_t position_hash(const struct graph_t* graph, const size_t pos[2], const size_t num_walls[2], enum color_t to_move) {
+	uint64_t hash = graph->hash;
+	for (enum color_t color = BLACK; color <= WHITE; color++)
+		hash ^= zobrist_pawn(color, pos[color]) ^ zobrist_walls_left(color, num_walls[color]);
+	return to_move == WHITE ? hash ^ zobrist_side() : hash;
 }
@@ -4,232 +4,424 @@
 #include <string.h>
 #include <limits.h>
 #include <time.h>
+#include <pthread.h>
+#include <unistd.h>
 #include "ia.h"
+#include "ia_utils.h"
+#include "board.h"
 #include "move.h"
+#include "geralt.h"
 
-#define EDGE(graph, i, j) ((graph)[(i) * n2 + (j)])
-
-#define DISPLACEMENT_MOVE(inc)        (MOVE << 24 | ((inc) & 0xFFFF))
-#define WALL_MOVE(corner, horizontal) (WALL << 24 | (horizontal) << 16 | ((corner) & 0xFFFF))
-
-#define QUEUE_ADD(array, capacity, start, size, value) ((array)[((start) + (size)++) % (capacity)] = (value))
-#define QUEUE_REMOVE(array, capacity, start, size) ((array)[(start)++ % (capacity)]); --(size)
 
 #define SCORE_LIMIT INT_MAX
 #define INVALID_MOVE_SCORE (-SCORE_LIMIT)
 #define WIN_SCORE (SCORE_LIMIT)
 #define LOOSE_SCORE (-WIN_SCORE)
 
-#define TOTAL_TIME_AVAILABLE 15000
-#define AVG_NB_OF_TURN 100
+// time management: a move gets the time left for the game divided by the number of moves still expected,
+// no iteration is started past this budget (scaled by the stability of the best move) or when it would
+// not end before the hard limit, where the search is aborted, the clock is read every CLOCK_CHECK_INTERVAL nodes
+#define DEFAULT_GAME_TIME 15000
+#define MIN_MOVE_TIME 10
+#define MOVES_LEFT_MARGIN 8
+#define HARD_LIMIT_FACTOR 3
+#define STABLE_ITERATIONS 4
+#define CLOCK_CHECK_INTERVAL 1024
+
+// scores above WIN_THRESHOLD (or under -WIN_THRESHOLD) are wins (or losses) found by the search
+#define WIN_THRESHOLD (WIN_SCORE - 1000000)
+
+#define TT_DEFAULT_MB 16
+#define TT_BUCKET_SIZE 4
+
+// move ordering, from the first searched to the last: table move, killers, pawn moves, then walls
+// cutting a shortest path of the opponent, walls cutting one of the player and the others, each by history
+// moves held by the buffers of a search context over all its plies, which are fewer than MAX_PLY on large boards
+#define MAX_MOVE_ENTRIES (1 << 22)
+#define OPPONENT_PATH_ORDER (1 << 26)
+#define OWN_PATH_ORDER (1 << 25)
+#define HISTORY_LIMIT (1 << 24)
+
+// the history of the previous move is kept, divided by 2^HISTORY_AGING
+#define HISTORY_AGING 2
+
+// walls cutting no shortest path searched at each node, can be set with GERALT_EXTRA_WALLS
+#define DEFAULT_EXTRA_WALLS 8
+
+// search techniques, each one can be turned on or off with its environment variable (1 or 0):
+// principal variation search (GERALT_PVS), aspiration windows around the score of the previous
+// iteration (GERALT_ASPIRATION), late move reductions of the walls ranked after the first LMR_FIRST_WALL
+// ones (GERALT_LMR) and null move pruning (GERALT_NULL_MOVE), verified when the player has no walls left
+#define ASPIRATION_WINDOW 16
+#define LMR_FIRST_WALL 4
+#define LMR_MIN_DEPTH 3
+#define LMR_REDUCTION 1
+#define NULL_MOVE_REDUCTION 2
+
+// pawn races, once no player has walls left, are solved exactly (GERALT_RACE), the scores of races
+// up to MAX_RACE_LENGTH plies stay above WIN_THRESHOLD, the table of the solved races has 2^RACE_TABLE_BITS entries
+#define MAX_RACE_LENGTH 999
+#define RACE_TABLE_BITS 16
+
+// transposition table, shared by the search threads without locks, a bucket fills a cache line
+
+enum tt_bound_t { TT_EXACT, TT_LOWER, TT_UPPER };
 
-// define simplified structures to gain efficiency
+typedef struct {
+	uint32_t check;        // upper half of the position hash
+	unsigned move;         // best move found, 0 if none
+	int score;
+	uint8_t depth;         // remaining depth of the search that stored the entry
+	uint8_t bound;
+	uint16_t generation;   // number of the move during which the entry was stored
+} TTEntry;
+
+// an entry packed in two words, the key is xored with the data so that an entry
+// torn by two threads writing it at the same time fails the check and is ignored
+typedef struct {
+	uint64_t key;          // data ^ (check | depth << 32 | bound << 40 | generation << 48)
+	uint64_t data;         // move | score << 32
+} TTSlot;
 
 typedef struct {
-	char *graph;
-	int pos;
-	int num_walls;
-	int opponent_pos;
-	int opponent_num_walls;
-	int *start_pos;
-	int *opponent_start_pos;
-	bool target_is_up;
-} SimpleGameState;
+	TTSlot slots[TT_BUCKET_SIZE];
+} __attribute__((aligned(64))) TTBucket;
+
+// distances of a breadth first search, stamped with the generation of the search in the upper 16 bits,
+// so that a new search does not need to clear the buffer (the distances are below n2, so below 1 << 16)
+typedef struct {
+	unsigned *stamped;     // (generation << 16) + distance for the vertices reached by the last search
+	unsigned base;         // generation << 16 of the last search
+} BfsBuffer;
+
+// buffers of a search, allocated once so that the search itself does not allocate memory
+typedef struct {
+	unsigned *moves;       // moves of each ply, the moves of ply p start at p * max_moves_per_ply
+	int *scores;           // scores of the moves, with the same layout
+	uint8_t *marks;        // shortest paths of the player and of the opponent at each ply, 2 * n2 per ply
+	int *queue;            // queue of the breadth first searches
+	BfsBuffer bfs[2];
+	GoalFields fields;     // distances to the target line of both colors from every vertex at each ply
+	unsigned killers[MAX_PLY][2]; // two moves which caused a cutoff at each ply
+	int *history;          // cutoffs of each move weighted by the remaining depth, see history_index()
+	RaceTable races;       // pawn races solved by the search
+	long time_limit;       // the search is aborted after this time, LONG_MAX for no limit
+	bool aborted;
+	uint64_t nodes;        // number of nodes searched during the current move
+	uint64_t tt_probes;    // probes of the transposition table during the current move, and the ones finding an entry
+	uint64_t tt_hits;
+	uint64_t cutoffs;      // beta cutoffs during the current move, and the ones caused by the first move searched
+	uint64_t first_move_cutoffs;
+} SearchContext;
+
+// summary of the search of the last move, written to the telemetry stream
+typedef struct {
+	int depth;             // depth of the last iteration completed
+	int score;             // score of the last iteration completed
+	long budget;           // time budget and hard limit of the move in milliseconds
+	long hard_limit;
+	uint64_t iteration_nodes[2]; // nodes of the main thread in the two last iterations completed, the last one second
+} SearchReport;
+
+// helper thread of the parallel search, with its own copy of the game
+typedef struct {
+	pthread_t thread;
+	SearchContext context;
+	SimpleGameState game;
+	int first_depth;       // depth of the first iteration, odd helpers skip one to desynchronize the threads
+} SearchThread;
+
+// debug builds count the allocations of the player, none should happen once the game has started
+#ifdef DEBUG
+size_t nb_of_allocations = 0;
+#define COUNT_ALLOCATION() (++nb_of_allocations)
+#else
+#define COUNT_ALLOCATION() ((void) 0)
+#endif
+#define ALLOCATE(size) (COUNT_ALLOCATION(), malloc(size))
 
 
 // data initialized once (doesn't change from one move to another)
 
 char *name = "Geralt";
+// the search plays on its own compact copy of the board, so the board shared by the server is enough
+bool board_read_only = true;
 int n;
 int n2;
-int n4;
 int nb_of_start_pos;
 int *start_pos;
 int *opponent_start_pos;
 bool target_is_up;
+enum color_t self_color;
+int extra_walls;
+
+TTBucket *tt = NULL;
+size_t tt_mask;
+uint16_t tt_generation = 0;
+
+// the compressed game is kept from one move to the next, in the position after the move of the player,
+// the move of the opponent is then applied to it, it is rebuilt if the result differs from the real position
+SearchContext search_context;
+SimpleGameState compressed_game;
+bool compressed_game_valid = false;
+int max_moves_per_ply;
+int history_size;
+// plies held by the buffers of a search context, the depth of the searches stays under it
+int search_plies;
+// Geralt can't search boards wider than GERALT_MAX_WIDTH, its pawn then follows a shortest path
+bool board_too_large = false;
+
+// lazy SMP: the helper threads search the same position and share their results through the table,
+// the move is the one of the main thread, which sets search_stopped when it is done
+int nb_of_threads;
+SearchThread *helpers = NULL;
+int search_stopped;
+
+bool use_pvs;
+bool use_aspiration;
+bool use_lmr;
+bool use_null_move;
+bool use_race_solver;
+
+// with a fixed depth, the search ignores the clock and its result only depends on the position (with one thread)
+int fixed_depth;
+
+// pondering, enabled with GERALT_PONDER: during the turn of the opponent, a thread searches the position
+// after the move played, with the buffers of the main search, and the next search starts from the filled table
+bool ponder_enabled;
+bool pondering = false;
+SearchThread ponder;
+#ifdef DEBUG
+uint64_t predicted_hash;  // position after the reply expected by the pondering search
+#endif
+
+// time of the whole game in milliseconds, can be set with GERALT_GAME_TIME, and time spent on the previous moves
+long game_time;
+long time_used;
+
+// telemetry, enabled with GERALT_TELEMETRY: a line of JSON is appended to the stream after each move
+FILE *telemetry = NULL;
+SearchReport last_search;
+int moves_played;
+
+// start a new search on a buffer, forgetting the distances of the previous one
+void bfs_clear(BfsBuffer *bfs) {
+	bfs->base += 1 << 16;
+	if (bfs->base == 0) {
+		memset(bfs->stamped, 0, n2 * sizeof(unsigned));
+		bfs->base = 1 << 16;
+	}
+}
 
-void add_displacement_moves(const char *graph, unsigned *moves, int *nb_of_moves, int player_pos, int opponent_pos, char main_direction, char secondary_direction) {
-	char edge;
+// distance of a vertex, -1 if it has not been reached by the last search
+static inline int bfs_distance(const BfsBuffer *bfs, int pos) {
+	return bfs->stamped[pos] >= bfs->base ? (int) (bfs->stamped[pos] - bfs->base) : -1;
+}
 
-	int step_1 = player_pos + main_direction;
-	if (step_1 < 0 || step_1 >= n2 || (edge = EDGE(graph, player_pos, step_1)) == 0 || edge > 4) {
-		return;
-	}
+static inline void bfs_set_distance(BfsBuffer *bfs, int pos, int dist) {
+	bfs->stamped[pos] = bfs->base + dist;
+}
 
-	if (step_1 != opponent_pos) {
-		moves[(*nb_of_moves)++] = DISPLACEMENT_MOVE(main_direction);
-		return;
+// distances from the sources already in the queue and in the buffer
+void distances_from(const uint8_t *cells, int *queue, int size, BfsBuffer *bfs) {
+	const int offsets[MAX_DIRECTION] = {0, -n, n, -1, 1};
+
+	for (int head = 0; head < size; ++head) {
+		int current_pos = queue[head];
+		for (enum direction_t d = NORTH; d <= EAST; ++d) {
+			int new_pos = current_pos + offsets[d];
+			if (!(cells[current_pos] & 1 << d) && bfs_distance(bfs, new_pos) == -1) {
+				bfs_set_distance(bfs, new_pos, bfs_distance(bfs, current_pos) + 1);
+				queue[size++] = new_pos;
+			}
+		}
 	}
+}
 
-	int step_2 = step_1 + main_direction;
-	if (step_2 >= 0 && step_2 < n2 && (edge = EDGE(graph, step_1, step_2)) >= 1 && edge <= 4) {
-		moves[(*nb_of_moves)++] = DISPLACEMENT_MOVE(step_2 - player_pos);
-		return;
-	}
+// mark the edges on the shortest paths of a player to its target line, as in mark_shortest_paths(),
+// the distances to the line are those of the field of the player at the ply
+void mark_path_edges(SearchContext *context, SimpleGameState *game, int ply, int pos, bool self, uint8_t *marks) {
+	const int offsets[MAX_DIRECTION] = {0, -n, n, -1, 1};
+
+	int *queue = context->queue;
+	const uint16_t *to = goal_field(&context->fields, game, ply, self ? game->color : 1 - game->color);
+	BfsBuffer *from = &context->bfs[1];
+	bfs_clear(from);
 
-	step_2 = step_1 + secondary_direction;
-	if (step_2 >= 0 && step_2 < n2 && (edge = EDGE(graph, step_1, step_2)) >= 1 && edge <= 4) {
-		moves[(*nb_of_moves)++] = DISPLACEMENT_MOVE(step_2 - player_pos);
+	// distances from the pawn, or from the start positions if it is not on the board yet
+	int nb_of_sources = 1;
+	if (pos == -1) {
+		nb_of_sources = nb_of_start_pos;
+		memcpy(queue, self ? game->start_pos : game->opponent_start_pos, nb_of_start_pos * sizeof(int));
+	} else {
+		queue[0] = pos;
 	}
 
-	step_2 = step_1 - secondary_direction;
-	if (step_2 >= 0 && step_2 < n2 && (edge = EDGE(graph, step_1, step_2)) >= 1 && edge <= 4) {
-		moves[(*nb_of_moves)++] = DISPLACEMENT_MOVE(step_2 - player_pos);
+	int length = INT_MAX;
+	for (int i = 0; i < nb_of_sources; ++i) {
+		bfs_set_distance(from, queue[i], 0);
+		if (to[queue[i]] < length) {
+			length = to[queue[i]];
+		}
 	}
-}
+	distances_from(game->cells, queue, nb_of_sources, from);
 
-void add_wall_moves(const char *graph, unsigned *moves, int *nb_of_moves) {
-	for (int i = 0; i < n - 1; ++i) {
-		for (int j = 0; j < n - 1; ++j) {
-			/*
-			 * a -e- b
-			 * |     |
-			 * g     h
-			 * |     |
-			 * c -f- d
-			 */
-			int a = i * n + j;
-			int b = a + 1;
-			int c = a + n;
-			int d = b + n;
-			char e = EDGE(graph, a, b);
-			char f = EDGE(graph, c, d);
-			char g = EDGE(graph, a, c);
-			char h = EDGE(graph, b, d);
+	for (int u = 0; u < n2; ++u) {
+		int from_u = bfs_distance(from, u);
+		int to_u = to[u];
+		if (from_u == -1 || to_u == UNREACHABLE || from_u + to_u != length) {
+			continue;
+		}
 
-			if (e >= 1 && e <= 4 && f >= 1 && f <= 4 && g != 7) {
-				moves[(*nb_of_moves)++] = WALL_MOVE(a, false);
+		marks[u] |= ON_SHORTEST_PATH;
+		for (enum direction_t d = NORTH; d <= EAST; ++d) {
+			int v = u + offsets[d];
+			if (!(game->cells[u] & 1 << d) && bfs_distance(from, v) == from_u + 1 && to[v] == to_u - 1) {
+				marks[u] |= 1 << d;
+				marks[v] |= 1 << opposite(d);
 			}
+		}
+	}
+}
+
+bool wall_cuts_path(const uint8_t *marks, int corner, bool horizontal) {
+	if (horizontal) {
+		return (marks[corner] | marks[corner + 1]) & CLOSED_SOUTH;
+	}
+	return (marks[corner] | marks[corner + n]) & CLOSED_EAST;
+}
 
-			if (g >= 1 && g <= 4 && h >= 1 && h <= 4 && e != 5) {
-				moves[(*nb_of_moves)++] = WALL_MOVE(a, true);
+// add the walls cutting a shortest path of one of the players, marked in marks[0] and marks[1],
+// and at most extra_walls of the walls touching one of these paths
+void add_wall_moves(const struct wall_slots_t *slots, uint8_t *marks[2], unsigned *moves, int *nb_of_moves) {
+	int nb_of_extra_walls = 0;
+
+	for (size_t w = 0; w < slots->words; ++w) {
+		uint64_t free_corners = slots->free[HORIZONTAL][w] | slots->free[VERTICAL][w];
+
+		while (free_corners) {
+			int a = (int) (w * 64) + __builtin_ctzll(free_corners);
+			free_corners &= free_corners - 1;
+
+			for (int horizontal = 0; horizontal <= 1; ++horizontal) {
+				if (!(slots->free[horizontal ? HORIZONTAL : VERTICAL][w] >> (a % 64) & 1)) {
+					continue;
+				}
+
+				if (wall_cuts_path(marks[0], a, horizontal) || wall_cuts_path(marks[1], a, horizontal)) {
+					moves[(*nb_of_moves)++] = WALL_MOVE(a, horizontal);
+				} else if (nb_of_extra_walls < extra_walls
+						&& ((marks[0][a] | marks[0][a + 1] | marks[0][a + n] | marks[0][a + n + 1]
+						| marks[1][a] | marks[1][a + 1] | marks[1][a + n] | marks[1][a + n + 1]) & ON_SHORTEST_PATH)) {
+					moves[(*nb_of_moves)++] = WALL_MOVE(a, horizontal);
+					++nb_of_extra_walls;
+				}
 			}
 		}
 	}
 }
 
-unsigned *get_possible_moves(SimpleGameState *game, int *nb_of_moves) {
-	unsigned *moves;
+// fill the moves, marks[0] and marks[1] get the shortest paths of the player and of the opponent if walls are added
+int get_possible_moves(SearchContext *context, SimpleGameState *game, int ply, unsigned *moves, uint8_t *marks[2]) {
+	int nb_of_moves = 0;
 
 	if (game->pos == -1) {
-		moves = malloc(nb_of_start_pos * sizeof(unsigned));
 		for (int i = 0; i < nb_of_start_pos; ++i) {
-			moves[i] = DISPLACEMENT_MOVE(game->start_pos[i] - game->pos);
+			moves[nb_of_moves++] = DISPLACEMENT_MOVE(game->start_pos[i] - game->pos);
 		}
-		*nb_of_moves = nb_of_start_pos;
-		return moves;
+		return nb_of_moves;
 	}
 
-	moves = malloc((2 * (n - 1) * (n - 1) + 5) * sizeof(unsigned));
-	*nb_of_moves = 0;
-
-	add_displacement_moves(game->graph, moves, nb_of_moves, game->pos, game->opponent_pos, 1, (char) n);
-	add_displacement_moves(game->graph, moves, nb_of_moves, game->pos, game->opponent_pos, -1, (char) n);
-	add_displacement_moves(game->graph, moves, nb_of_moves, game->pos, game->opponent_pos, (char) n, 1);
-	add_displacement_moves(game->graph, moves, nb_of_moves, game->pos, game->opponent_pos, (char) -n, 1);
+	add_displacement_moves(game, moves, &nb_of_moves);
 
 	if (game->num_walls > 0) {
-		add_wall_moves(game->graph, moves, nb_of_moves);
+		memset(marks[0], 0, n2);
+		memset(marks[1], 0, n2);
+		mark_path_edges(context, game, ply, game->pos, true, marks[0]);
+		mark_path_edges(context, game, ply, game->opponent_pos, false, marks[1]);
+		add_wall_moves(game->slots, marks, moves, &nb_of_moves);
 	}
 
-	moves = realloc(moves, *nb_of_moves * sizeof(unsigned));
-	return moves;
+	return nb_of_moves;
 }
 
-int distance(SimpleGameState *game, int pos, bool self) {
+int distance(SearchContext *context, SimpleGameState *game, int pos, bool self) {
 	bool current_target_is_up = self == game->target_is_up;
-	int dist;
-
-	bool flags[n2];
-	memset(flags, true, n2 * sizeof(bool));
-	flags[pos] = false;
-
-	int queue[n2];
-	int queue_start = 0;
-	int queue_size;
+	const int offsets[MAX_DIRECTION] = {0, -n, n, -1, 1};
 
-	int iteration_length;
-	int next_iteration_length = 0;
+	int *queue = context->queue;
+	int queue_size = 0;
+	BfsBuffer *bfs = &context->bfs[0];
+	bfs_clear(bfs);
 
+	// a player who is not on the board yet needs a first move to enter it
 	if (pos == -1) {
-		dist = 1;
-		iteration_length = nb_of_start_pos;
-		queue_size = nb_of_start_pos;
-
 		for (int i = 0; i < nb_of_start_pos; ++i) {
-			queue[i] = (self ? game->start_pos : game->opponent_start_pos)[i];
+			int start = (self ? game->start_pos : game->opponent_start_pos)[i];
+			bfs_set_distance(bfs, start, 1);
+			queue[queue_size++] = start;
 		}
-
 	} else {
-		dist = 0;
-		iteration_length = 1;
-		queue_size = 1;
-		queue[0] = pos;
+		queue[queue_size++] = pos;
+		bfs_set_distance(bfs, pos, 0);
 	}
 
-	while (queue_size > 0) {
-		int current_pos = QUEUE_REMOVE(queue, n2, queue_start, queue_size);
+	for (int head = 0; head < queue_size; ++head) {
+		int current_pos = queue[head];
 
 		if ((current_target_is_up && current_pos < n) || (!current_target_is_up && current_pos >= n2 - n)) {
-			return dist;
+			return bfs_distance(bfs, current_pos);
 		}
 
-		int new_pos;
-		char edge;
-
-		// north
-		new_pos = current_pos - n;
-		if (new_pos >= 0 && flags[new_pos] && (edge = EDGE(game->graph, current_pos, new_pos)) >= 1 && edge <= 4) {
-			flags[new_pos] = false;
-			QUEUE_ADD(queue, n2, queue_start, queue_size, new_pos);
-			++next_iteration_length;
+		for (enum direction_t d = NORTH; d <= EAST; ++d) {
+			int new_pos = current_pos + offsets[d];
+			if (!(game->cells[current_pos] & 1 << d) && bfs_distance(bfs, new_pos) == -1) {
+				bfs_set_distance(bfs, new_pos, bfs_distance(bfs, current_pos) + 1);
+				queue[queue_size++] = new_pos;
+			}
 		}
+	}
 
-		// south
-		new_pos = current_pos + n;
-		if (new_pos < n2 && flags[new_pos] && (edge = EDGE(game->graph, current_pos, new_pos)) >= 1 && edge <= 4) {
-			flags[new_pos] = false;
-			QUEUE_ADD(queue, n2, queue_start, queue_size, new_pos);
-			++next_iteration_length;
-		}
+	return -1;
+}
 
-		// west
-		new_pos = current_pos - 1;
-		if (new_pos >= 0 && flags[new_pos] && (edge = EDGE(game->graph, current_pos, new_pos)) >= 1 && edge <= 4) {
-			flags[new_pos] = false;
-			QUEUE_ADD(queue, n2, queue_start, queue_size, new_pos);
-			++next_iteration_length;
-		}
+// distance of a player to its target line at a ply, -1 if it can't reach it
+static inline int field_distance(SearchContext *context, SimpleGameState *game, int ply, bool self) {
+	enum color_t color = self ? game->color : 1 - game->color;
+	int owner = context->fields.owner[ply][color];
+	int pos = self ? game->pos : game->opponent_pos;
 
-		// east
-		new_pos = current_pos + 1;
-		if (new_pos < n2 && flags[new_pos] && (edge = EDGE(game->graph, current_pos, new_pos)) >= 1 && edge <= 4) {
-			flags[new_pos] = false;
-			QUEUE_ADD(queue, n2, queue_start, queue_size, new_pos);
-			++next_iteration_length;
-		}
+	// a field of the ply itself would not be shared with other positions, a search from the pawn
+	// is faster as it stops at the first vertex of the line
+	if (owner == ply && !context->fields.ready[owner][color]) {
+		return distance(context, game, pos, self);
+	}
+	const uint16_t *field = goal_field(&context->fields, game, ply, color);
 
-		--iteration_length;
+	if (pos != -1) {
+		return field[pos] == UNREACHABLE ? -1 : field[pos];
+	}
 
-		if (iteration_length == 0) {
-			iteration_length = next_iteration_length;
-			next_iteration_length = 0;
-			++dist;
+	// a player who is not on the board yet needs a first move to enter it
+	int dist = UNREACHABLE;
+	const int *starts = self ? game->start_pos : game->opponent_start_pos;
+	for (int i = 0; i < nb_of_start_pos; ++i) {
+		if (field[starts[i]] < dist) {
+			dist = field[starts[i]];
 		}
 	}
-
-	return -1;
+	return dist == UNREACHABLE ? -1 : dist + 1;
 }
 
-int evaluate(SimpleGameState *game, int depth) {
-	int dist = distance(game, game->pos, true);
+int evaluate(SearchContext *context, SimpleGameState *game, int depth) {
+	int dist = field_distance(context, game, depth, true);
 
 	// invalid move (no possible path)
 	if (dist == -1) {
 		return INVALID_MOVE_SCORE;
 	}
 
-	int opponent_dist = distance(game, game->opponent_pos, false);
+	int opponent_dist = field_distance(context, game, depth, false);
 
 	// invalid move (no possible path)
 	if (opponent_dist == -1) {
@@ -259,106 +451,235 @@ int evaluate(SimpleGameState *game, int depth) {
 	return score;
 }
 
-void invert_int(int *a, int *b) {
-	int tmp = *a;
-	*a = *b;
-	*b = tmp;
+void tt_init(size_t megabytes) {
+	size_t num_buckets = 1;
+	while (2 * num_buckets * sizeof(TTBucket) <= megabytes << 20) {
+		num_buckets *= 2;
+	}
+
+	void *memory;
+	COUNT_ALLOCATION();
+	if (posix_memalign(&memory, sizeof(TTBucket), num_buckets * sizeof(TTBucket)) != 0) {
+		exit(EXIT_FAILURE);
+	}
+	tt = memory;
+	tt_mask = num_buckets - 1;
+	memset(tt, 0, num_buckets * sizeof(TTBucket));
 }
 
-void invert_ptr(int **a, int **b) {
-	int *tmp = *a;
-	*a = *b;
-	*b = tmp;
+TTEntry tt_read(TTSlot *slot) {
+	uint64_t data = __atomic_load_n(&slot->data, __ATOMIC_RELAXED);
+	uint64_t key = __atomic_load_n(&slot->key, __ATOMIC_RELAXED) ^ data;
+
+	return (TTEntry) {
+		.check = (uint32_t) key,
+		.move = (unsigned) data,
+		.score = (int) (uint32_t) (data >> 32),
+		.depth = (uint8_t) (key >> 32),
+		.bound = (uint8_t) (key >> 40),
+		.generation = (uint16_t) (key >> 48)
+	};
 }
 
-void change_side(SimpleGameState *game) {
-	invert_int(&game->pos, &game->opponent_pos);
-	invert_int(&game->num_walls, &game->opponent_num_walls);
-	invert_ptr(&game->start_pos, &game->opponent_start_pos);
-	game->target_is_up = !game->target_is_up;
+void tt_write(TTSlot *slot, TTEntry entry) {
+	uint64_t data = entry.move | (uint64_t) (uint32_t) entry.score << 32;
+	uint64_t key = entry.check | (uint64_t) entry.depth << 32 | (uint64_t) entry.bound << 40 | (uint64_t) entry.generation << 48;
+
+	__atomic_store_n(&slot->key, key ^ data, __ATOMIC_RELAXED);
+	__atomic_store_n(&slot->data, data, __ATOMIC_RELAXED);
 }
 
-void apply_move(SimpleGameState *state, unsigned move) {
-	enum movetype_t move_type = move >> 24;
-	int embed_int = (int) (move & 0x8000 ? move | 0xFFFF0000 : move & 0xFFFF);
-	bool embed_bool = move >> 16 & 0xFF;
+bool tt_probe(uint64_t hash, TTEntry *entry) {
+	TTBucket *bucket = &tt[hash & tt_mask];
+	for (int i = 0; i < TT_BUCKET_SIZE; ++i) {
+		*entry = tt_read(&bucket->slots[i]);
+		if (entry->check == (uint32_t) (hash >> 32) && entry->depth > 0) {
+			return true;
+		}
+	}
+	return false;
+}
 
-	switch (move_type) {
-		case MOVE:
-			state->pos += embed_int;
+void tt_store(uint64_t hash, int depth, enum tt_bound_t bound, int score, unsigned move) {
+	TTBucket *bucket = &tt[hash & tt_mask];
+
+	// replace the same position, else the entry of an older move or with the lowest depth
+	int replaced = 0;
+	TTEntry replaced_entry = tt_read(&bucket->slots[0]);
+	for (int i = 0; i < TT_BUCKET_SIZE; ++i) {
+		TTEntry entry = tt_read(&bucket->slots[i]);
+		if (entry.check == (uint32_t) (hash >> 32)) {
+			if (depth < entry.depth && entry.generation == tt_generation) {
+				return;
+			}
+			replaced = i;
 			break;
+		}
+		if ((entry.generation != tt_generation) > (replaced_entry.generation != tt_generation)
+				|| ((entry.generation != tt_generation) == (replaced_entry.generation != tt_generation) && entry.depth < replaced_entry.depth)) {
+			replaced = i;
+			replaced_entry = entry;
+		}
+	}
 
-		case WALL:
-			--(state->num_walls);
+	tt_write(&bucket->slots[replaced], (TTEntry) {
+		.check = (uint32_t) (hash >> 32),
+		.move = move,
+		.score = score,
+		.depth = (uint8_t) depth,
+		.bound = bound,
+		.generation = tt_generation
+	});
+}
 
-			// get nodes
-			int first_node = embed_int;
-			int second_node = first_node + (embed_bool ? n : 1);
+// win scores depend on the depth of the win from the root, the table stores the distance from the node instead
+int isqrt(int x) {
+	int r = 0;
+	while ((r + 1) * (r + 1) <= x) {
+		++r;
+	}
+	return r;
+}
 
-			if (first_node + 1 == second_node) {
-				// vertical wall
-				EDGE(state->graph, first_node, second_node) = 5;
-				EDGE(state->graph, second_node, first_node) = 5;
+int score_to_tt(int score, int current_depth) {
+	if (score > WIN_THRESHOLD && score < WIN_SCORE) {
+		return WIN_SCORE - (isqrt(WIN_SCORE - score) - current_depth);
+	}
+	if (score < -WIN_THRESHOLD && score > LOOSE_SCORE) {
+		return LOOSE_SCORE + (isqrt(score - LOOSE_SCORE) - current_depth);
+	}
+	return score;
+}
 
-				EDGE(state->graph, first_node + n, second_node + n) = 6;
-				EDGE(state->graph, second_node + n, first_node + n) = 6;
-			} else {
-				// horizontal wall
-				EDGE(state->graph, first_node, second_node) = 7;
-				EDGE(state->graph, second_node, first_node) = 7;
+int score_from_tt(int score, int current_depth) {
+	if (score > WIN_THRESHOLD && score < WIN_SCORE) {
+		int win_depth = current_depth + (WIN_SCORE - score);
+		return WIN_SCORE - win_depth * win_depth;
+	}
+	if (score < -WIN_THRESHOLD && score > LOOSE_SCORE) {
+		int loose_depth = current_depth + (score - LOOSE_SCORE);
+		return LOOSE_SCORE + loose_depth * loose_depth;
+	}
+	return score;
+}
 
-				EDGE(state->graph, first_node + 1, second_node + 1) = 8;
-				EDGE(state->graph, second_node + 1, first_node + 1) = 8;
-			}
+// index of a move of the player to move in the history, -1 if it is not recorded
+int history_index(const SimpleGameState *game, unsigned move) {
+	if (MOVE_TYPE(move) == WALL) {
+		return MOVE_VALUE(move) * 2 + MOVE_HORIZONTAL(move);
+	}
 
-			break;
+	// the moves from outside the board to a start position are not recorded, their offsets would share
+	// the entries of the pawn moves on the board
+	if (game->pos < 0) {
+		return -1;
+	}
+	int index = 2 * n2 + 2 * n + MOVE_VALUE(move);
+	return index < history_size ? index : -1;
+}
+
+// move the table move, the killers and the pawn moves to the front, return their number
+int order_first_moves(SearchContext *context, const SimpleGameState *game, unsigned *moves, int nb_of_moves, int current_depth, unsigned tt_move) {
+	const int *history = context->history;
 
-		default:
+	int ordered = 0;
+
+	for (int i = 0; i < nb_of_moves && tt_move != 0; ++i) {
+		if (moves[i] == tt_move) {
+			moves[i] = moves[ordered];
+			moves[ordered++] = tt_move;
 			break;
+		}
 	}
 
-	change_side(state);
-}
+	for (int k = 0; k < 2 && current_depth < MAX_PLY; ++k) {
+		unsigned killer = context->killers[current_depth][k];
+		for (int i = ordered; i < nb_of_moves && killer != 0; ++i) {
+			if (moves[i] == killer) {
+				moves[i] = moves[ordered];
+				moves[ordered++] = killer;
+				break;
+			}
+		}
+	}
 
-void undo_move(SimpleGameState *state, unsigned move) {
-	change_side(state);
+	// pawn moves by history, with an insertion sort as there are few of them
+	int first_displacement = ordered;
+	for (int i = ordered; i < nb_of_moves; ++i) {
+		if (MOVE_TYPE(moves[i]) == MOVE) {
+			unsigned move = moves[i];
+			moves[i] = moves[ordered];
+
+			int j = ordered++;
+			int index = history_index(game, move);
+			int score = index != -1 ? history[index] : 0;
+			for (; j > first_displacement; --j) {
+				int other_index = history_index(game, moves[j - 1]);
+				if ((other_index != -1 ? history[other_index] : 0) >= score) {
+					break;
+				}
+				moves[j] = moves[j - 1];
+			}
+			moves[j] = move;
+		}
+	}
 
-	enum movetype_t move_type = move >> 24;
-	int embed_int = (int) (move & 0x8000 ? move | 0xFFFF0000 : move & 0xFFFF);
-	bool embed_bool = move >> 16 & 0xFF;
+	return ordered;
+}
 
-	switch (move_type) {
-		case MOVE:
-			state->pos -= embed_int;
-			break;
+// score the wall moves which are not at the front, only done if none of the front moves caused a cutoff
+void score_walls(SearchContext *context, const SimpleGameState *game, uint8_t *marks[2], const unsigned *moves, int *scores, int nb_of_moves) {
+	for (int i = 0; i < nb_of_moves; ++i) {
+		unsigned move = moves[i];
+		int a = MOVE_VALUE(move);
+		bool horizontal = MOVE_HORIZONTAL(move);
+		int score = context->history[history_index(game, move)];
+
+		if (wall_cuts_path(marks[1], a, horizontal)) {
+			score += OPPONENT_PATH_ORDER;
+		} else if (wall_cuts_path(marks[0], a, horizontal)) {
+			score += OWN_PATH_ORDER;
+		}
 
-		case WALL:
-			++(state->num_walls);
+		scores[i] = score;
+	}
+}
 
-			// get nodes
-			int first_node = (short) (move & 0xFF);
-			int second_node = first_node + (embed_bool ? n : 1);
+// move the best scored of the remaining moves to the index i
+unsigned pick_move(unsigned *moves, int *scores, int i, int nb_of_moves) {
+	int best = i;
+	for (int j = i + 1; j < nb_of_moves; ++j) {
+		if (scores[j] > scores[best]) {
+			best = j;
+		}
+	}
 
-			if (first_node + 1 == second_node) {
-				// vertical wall
-				EDGE(state->graph, first_node, second_node) = 4;
-				EDGE(state->graph, second_node, first_node) = 3;
+	unsigned move = moves[best];
+	moves[best] = moves[i];
+	moves[i] = move;
+	invert_int(&scores[best], &scores[i]);
+	return move;
+}
 
-				EDGE(state->graph, first_node + n, second_node + n) = 4;
-				EDGE(state->graph, second_node + n, first_node + n) = 3;
-			} else {
-				// horizontal wall
-				EDGE(state->graph, first_node, second_node) = 2;
-				EDGE(state->graph, second_node, first_node) = 1;
+void record_cutoff(SearchContext *context, const SimpleGameState *game, unsigned move, int current_depth, int remaining_depth) {
+	unsigned (*killers)[2] = context->killers;
+	int *history = context->history;
 
-				EDGE(state->graph, first_node + 1, second_node + 1) = 2;
-				EDGE(state->graph, second_node + 1, first_node + 1) = 1;
-			}
+	if (current_depth < MAX_PLY && killers[current_depth][0] != move) {
+		killers[current_depth][1] = killers[current_depth][0];
+		killers[current_depth][0] = move;
+	}
 
-			break;
+	int index = history_index(game, move);
+	if (index == -1) {
+		return;
+	}
 
-		default:
-			break;
+	history[index] += remaining_depth * remaining_depth;
+	if (history[index] >= HISTORY_LIMIT) {
+		for (int i = 0; i < history_size; ++i) {
+			history[i] /= 2;
+		}
 	}
 }
 
@@ -374,101 +695,416 @@ bool is_game_terminated(SimpleGameState *game) {
 	}
 }
 
+// score of a race solved for the player to move, ending at the given ply, as the scores of evaluate()
+int race_score(enum race_result_t result, int end_ply) {
+	int length = end_ply < MAX_RACE_LENGTH ? end_ply : MAX_RACE_LENGTH;
+	return result == RACE_WIN ? WIN_SCORE - length * length : LOOSE_SCORE + length * length;
+}
+
 long get_time() {
 	struct timespec time;
-	clock_gettime(CLOCK_MONOTONIC_RAW, &time);
+	clock_gettime(CLOCK_MONOTONIC, &time);
 	return time.tv_sec * 1000 + time.tv_nsec / 1000000;
 }
 
-int alpha_beta(SimpleGameState *game, int current_depth, int final_depth, int alpha, int beta, unsigned *best_move, long time_limit, bool *aborted) {
-	if (*aborted || (final_depth > 1 && current_depth == 1 && get_time() > time_limit)) {
-		*aborted = true;
+int alpha_beta(SearchContext *context, SimpleGameState *game, int current_depth, int final_depth, int alpha, int beta, unsigned *best_move, bool null_move_allowed) {
+	// the first iteration is never aborted, so that there is always a move to play
+	if (context->aborted || __atomic_load_n(&search_stopped, __ATOMIC_RELAXED)
+			|| (final_depth > 1 && context->nodes % CLOCK_CHECK_INTERVAL == 0 && get_time() > context->time_limit)) {
+		context->aborted = true;
 		return 0;
 	}
+	++context->nodes;
+
+	// once no walls are left, the position is a race, which is solved, except at the root where the move is needed
+	if (use_race_solver && best_move == NULL && game->num_walls == 0 && game->opponent_num_walls == 0
+			&& game->pos != -1 && game->opponent_pos != -1) {
+		const uint16_t *fields[2] = {goal_field(&context->fields, game, current_depth, BLACK), goal_field(&context->fields, game, current_depth, WHITE)};
+		int plies;
+		enum race_result_t result = solve_race(&context->races, game, fields, &plies);
+		if (result != RACE_UNKNOWN) {
+			return race_score(result, current_depth + plies);
+		}
+	}
 
 	if (current_depth == final_depth || is_game_terminated(game)) {
-		return evaluate(game, current_depth);
+		return evaluate(context, game, current_depth);
+	}
+
+	// use the transposition table for a cutoff, except at the root where the move is needed
+	int remaining_depth = final_depth - current_depth;
+	int alpha_start = alpha;
+	TTEntry entry;
+	bool found = tt_probe(game->hash, &entry);
+	unsigned tt_move = found ? entry.move : 0;
+	++context->tt_probes;
+	context->tt_hits += found;
+
+	if (found && best_move == NULL && entry.depth >= remaining_depth) {
+		int score = score_from_tt(entry.score, current_depth);
+		if (entry.bound != TT_UPPER && score >= beta) {
+			return beta;
+		}
+		if (entry.bound != TT_LOWER && score <= alpha) {
+			return alpha;
+		}
+		if (entry.bound == TT_EXACT) {
+			return score;
+		}
 	}
 
-	int nb_of_moves;
-	unsigned *moves = get_possible_moves(game, &nb_of_moves);
+	// if passing the turn still fails high with a reduced depth, a move would too, except in a zugzwang,
+	// which can happen in a pawn race, so the result is then verified by a reduced search of the node
+	if (use_null_move && null_move_allowed && best_move == NULL && beta - alpha == 1 && remaining_depth > NULL_MOVE_REDUCTION
+			&& game->pos != -1 && game->opponent_pos != -1 && evaluate(context, game, current_depth) >= beta) {
+		null_move(game);
+		context->fields.owner[current_depth + 1][BLACK] = context->fields.owner[current_depth][BLACK];
+		context->fields.owner[current_depth + 1][WHITE] = context->fields.owner[current_depth][WHITE];
+		int score = -alpha_beta(context, game, current_depth + 1, final_depth - NULL_MOVE_REDUCTION, -beta, -beta + 1, NULL, false);
+		null_move(game);
+
+		if (context->aborted) {
+			return 0;
+		}
+		if (score >= beta && score != -INVALID_MOVE_SCORE && (game->num_walls > 0
+				|| alpha_beta(context, game, current_depth, final_depth - NULL_MOVE_REDUCTION, beta - 1, beta, NULL, false) >= beta)) {
+			return beta;
+		}
+	}
+
+	// at the root, the best move of the previous iteration is searched first
+	if (best_move != NULL && *best_move != 0) {
+		tt_move = *best_move;
+	}
 
+	unsigned *moves = context->moves + current_depth * max_moves_per_ply;
+	int *scores = context->scores + current_depth * max_moves_per_ply;
+	uint8_t *marks[2] = {context->marks + 2 * current_depth * n2, context->marks + (2 * current_depth + 1) * n2};
+
+	int nb_of_moves = get_possible_moves(context, game, current_depth, moves, marks);
+	int nb_of_ordered_moves = order_first_moves(context, game, moves, nb_of_moves, current_depth, tt_move);
+
+	unsigned node_best_move = 0;
+	bool has_valid_move = false;
 	for (int i = 0; i < nb_of_moves; ++i) {
-		unsigned move = moves[i];
+		if (i == nb_of_ordered_moves) {
+			score_walls(context, game, marks, moves + i, scores + i, nb_of_moves - i);
+		}
+		unsigned move = i < nb_of_ordered_moves ? moves[i] : pick_move(moves, scores, i, nb_of_moves);
+
+		// with the principal variation search, the moves after the first one are searched with a null window,
+		// to prove they are not better, and again with the full window if they are, the late walls are first
+		// searched with a reduced depth and searched again with the full depth if they are better
+		int reduction = use_lmr && i >= nb_of_ordered_moves + LMR_FIRST_WALL && remaining_depth >= LMR_MIN_DEPTH ? LMR_REDUCTION : 0;
+		bool full_window = i == 0 || !use_pvs;
+		int score = alpha + 1;
 
 		apply_move(game, move);
-		int score = -alpha_beta(game, current_depth + 1, final_depth, -beta, -alpha, NULL, time_limit, aborted);
+		update_goal_fields(&context->fields, game, current_depth, move);
+		if (reduction > 0) {
+			score = -alpha_beta(context, game, current_depth + 1, final_depth - reduction, -alpha - 1, -alpha, NULL, true);
+		}
+		if (score > alpha && score != -INVALID_MOVE_SCORE && !full_window) {
+			score = -alpha_beta(context, game, current_depth + 1, final_depth, -alpha - 1, -alpha, NULL, true);
+		}
+		if (score > alpha && score != -INVALID_MOVE_SCORE && (full_window || score < beta)) {
+			score = -alpha_beta(context, game, current_depth + 1, final_depth, -beta, -alpha, NULL, true);
+		}
 		undo_move(game, move);
 
+		// the score of an aborted search is meaningless, the moves searched before stay valid at the root
+		if (context->aborted) {
+			return 0;
+		}
+
 		if (score == -INVALID_MOVE_SCORE) {
 			continue;
 		}
+		has_valid_move = true;
 
 		if (score >= beta) {
-			free(moves);
+			++context->cutoffs;
+			context->first_move_cutoffs += i == 0;
+			record_cutoff(context, game, move, current_depth, remaining_depth);
+			tt_store(game->hash, remaining_depth, TT_LOWER, score_to_tt(beta, current_depth), move);
 			return beta;
 		}
 
 		if (score > alpha) {
 			alpha = score;
+			node_best_move = move;
 			if (best_move) {
 				*best_move = move;
 			}
 		}
 	}
 
-	free(moves);
+	// a wall closing the last path of a player is only detected at the leaves, where the distance is computed,
+	// the node is then invalid whatever the window, which is not a bound to store
+	if (!has_valid_move) {
+		return INVALID_MOVE_SCORE;
+	}
+
+	if (!context->aborted && alpha > -SCORE_LIMIT && alpha < SCORE_LIMIT) {
+		tt_store(game->hash, remaining_depth, alpha > alpha_start ? TT_EXACT : TT_UPPER, score_to_tt(alpha, current_depth), node_best_move != 0 ? node_best_move : tt_move);
+	}
 	return alpha;
 }
 
-unsigned search_best_move(SimpleGameState *game) {
-	unsigned best_move = 0;
+// copy a game into the buffers of another one, allocated by alloc_game()
+void copy_game(const SimpleGameState *game, SimpleGameState *copy) {
+	uint8_t *cells = copy->cells;
+	struct wall_slots_t *slots = copy->slots;
 
-	int depth = 1;
-	long max_time = get_time() + TOTAL_TIME_AVAILABLE / AVG_NB_OF_TURN;
+	*copy = *game;
+	copy->cells = cells;
+	copy->slots = slots;
+	memcpy(copy->cells, game->cells, n2);
+	wall_slots_copy(copy->slots, game->slots);
+}
 
+// search of the root at the given depth, with an aspiration window around the score of the previous iteration
+// which is widened while the score falls outside of it
+int search_root(SearchContext *context, SimpleGameState *game, int depth, int previous_score, unsigned *best_move) {
+	reset_goal_fields(&context->fields);
+	if (!use_aspiration || depth <= 2 || previous_score > WIN_THRESHOLD || previous_score < -WIN_THRESHOLD) {
+		return alpha_beta(context, game, 0, depth, -SCORE_LIMIT, SCORE_LIMIT, best_move, true);
+	}
+
+	int delta = ASPIRATION_WINDOW;
+	int alpha = previous_score - delta;
+	int beta = previous_score + delta;
 	while (true) {
-		bool aborted = false;
-		unsigned best_move_for_current_depth;
-		alpha_beta(game, 0, depth, -SCORE_LIMIT, SCORE_LIMIT, &best_move_for_current_depth, max_time, &aborted);
+		int score = alpha_beta(context, game, 0, depth, alpha, beta, best_move, true);
+		if (context->aborted || (score > alpha && score < beta)
+				|| (score <= alpha && alpha == -SCORE_LIMIT) || (score >= beta && beta == SCORE_LIMIT)) {
+			return score;
+		}
+
+		delta = delta < WIN_THRESHOLD / 4 ? delta * 4 : SCORE_LIMIT;
+		if (score <= alpha) {
+			alpha = delta == SCORE_LIMIT ? -SCORE_LIMIT : previous_score - delta;
+		} else {
+			beta = delta == SCORE_LIMIT ? SCORE_LIMIT : previous_score + delta;
+		}
+	}
+}
+
+// iterative deepening of a helper thread, until the main thread stops the search
+void *helper_search(void *arg) {
+	SearchThread *helper = arg;
+	unsigned best_move = 0;
+	int score = 0;
+
+	for (int depth = helper->first_depth; depth < search_plies && !helper->context.aborted; ++depth) {
+		score = search_root(&helper->context, &helper->game, depth, score, &best_move);
+	}
+	return NULL;
+}
+
+// budget of a move: the time left shared by the moves expected until the end of the game, the distance
+// to the target line, the walls which can still be placed by the player or lengthen its path, and a margin
+long move_budget(SearchContext *context, SimpleGameState *game) {
+	int dist = distance(context, game, game->pos, true);
+	int moves_left = (dist > 0 ? dist : 0) + game->num_walls + game->opponent_num_walls + MOVES_LEFT_MARGIN;
+
+	long budget = (game_time - time_used) / moves_left;
+	return budget > MIN_MOVE_TIME ? budget : MIN_MOVE_TIME;
+}
+
+unsigned search_best_move(SearchContext *context, SimpleGameState *game) {
+	unsigned best_move = 0;
 
-		if (aborted) {
-			printf("(reached depth: %d)", depth - 1);
+	long start = get_time();
+	long budget = move_budget(context, game);
+	long hard_limit = HARD_LIMIT_FACTOR * budget;
+	if (hard_limit > (game_time - time_used) / 2) {
+		hard_limit = (game_time - time_used) / 2 > budget ? (game_time - time_used) / 2 : budget;
+	}
+	context->time_limit = fixed_depth > 0 ? LONG_MAX : start + hard_limit;
+	__atomic_store_n(&search_stopped, 0, __ATOMIC_RELAXED);
+	last_search = (SearchReport) {.budget = budget, .hard_limit = hard_limit};
+
+	int nb_of_helpers = 0;
+	for (; nb_of_helpers < nb_of_threads - 1; ++nb_of_helpers) {
+		SearchThread *helper = &helpers[nb_of_helpers];
+		copy_game(game, &helper->game);
+		helper->context.time_limit = LONG_MAX;
+		if (pthread_create(&helper->thread, NULL, helper_search, helper) != 0) {
 			break;
 		}
+	}
 
+	// the buffers of the search hold search_plies plies
+	int last_depth = fixed_depth > 0 && fixed_depth < search_plies ? fixed_depth : search_plies - 1;
+	int depth = 1;
+	int score = 0;
+	int stable_iterations = 0;
+	long iteration_time = 0;
+	while (depth <= last_depth) {
+		long iteration_start = get_time();
+		uint64_t iteration_start_nodes = context->nodes;
+		unsigned best_move_for_current_depth = best_move;
+		score = search_root(context, game, depth, score, &best_move_for_current_depth);
+
+		// the root moves are searched from the previous best one, a move found before the abort is better
+		if (context->aborted) {
+			best_move = best_move_for_current_depth;
+			break;
+		}
+
+		last_search.depth = depth;
+		last_search.score = score;
+		last_search.iteration_nodes[0] = last_search.iteration_nodes[1];
+		last_search.iteration_nodes[1] = context->nodes - iteration_start_nodes;
+
+		stable_iterations = best_move_for_current_depth == best_move ? stable_iterations + 1 : 0;
 		best_move = best_move_for_current_depth;
 		++depth;
+
+		if (fixed_depth > 0) {
+			continue;
+		}
+
+		// a new iteration gets more time when the best move just changed, less when it stays the same,
+		// and it should last at least as many times the previous one as this one lasted the one before
+		long now = get_time();
+		long previous_iteration_time = iteration_time;
+		iteration_time = now - iteration_start;
+		long predicted_time = previous_iteration_time > 0 && iteration_time > 2 * previous_iteration_time
+				? iteration_time * iteration_time / previous_iteration_time : 2 * iteration_time;
+		long scaled_budget = stable_iterations == 0 ? 3 * budget / 2 : stable_iterations < STABLE_ITERATIONS ? budget : budget / 3;
+		if (now - start > scaled_budget || now + predicted_time > context->time_limit
+				|| score > WIN_THRESHOLD || score < -WIN_THRESHOLD) {
+			break;
+		}
+	}
+	printf("(reached depth: %d)", depth - 1);
+
+	__atomic_store_n(&search_stopped, 1, __ATOMIC_RELAXED);
+	for (int i = 0; i < nb_of_helpers; ++i) {
+		pthread_join(helpers[i].thread, NULL);
 	}
 
 	return best_move;
 }
 
-SimpleGameState compress_game(struct game_state_t game) {
-	SimpleGameState compressed = {
-		.graph = malloc(n4),
-		.pos = game.self.pos == SIZE_MAX ? -1 : (int) game.self.pos,
-		.num_walls = (int) game.self.num_walls,
-		.opponent_pos = game.opponent.pos == SIZE_MAX ? -1 : (int) game.opponent.pos,
-		.opponent_num_walls = (int) game.opponent.num_walls,
-		.start_pos = start_pos,
-		.opponent_start_pos = opponent_start_pos,
-		.target_is_up = target_is_up
-	};
+// keep the tables of a search whose root was the given number of plies before the next one,
+// the killers are moved to the plies of the next search and the history is aged
+void age_search_context(SearchContext *context, int plies) {
+	memmove(context->killers, context->killers + plies, (MAX_PLY - plies) * sizeof(context->killers[0]));
+	memset(context->killers + MAX_PLY - plies, 0, plies * sizeof(context->killers[0]));
+	for (int i = 0; i < history_size; ++i) {
+		context->history[i] >>= HISTORY_AGING;
+	}
+}
 
-	for (int i = 0; i < n2; ++i) {
-		for (int j = 0; j < n2; ++j) {
-			EDGE(compressed.graph, i, j) = (char) gsl_spmatrix_uint_get(game.graph->t, i, j);
+// start pondering once the move is chosen and applied to compressed_game,
+// which is not used until the next move, as search_context
+void start_pondering() {
+	ponder.context = search_context;
+	ponder.context.aborted = false;
+	// the deadline of the move just played is not the one of the ponder search, which stop_pondering() ends
+	ponder.context.time_limit = LONG_MAX;
+	ponder.game = compressed_game;
+	ponder.first_depth = 1;
+
+	if (is_game_terminated(&ponder.game)) {
+		return;
+	}
+	__atomic_store_n(&search_stopped, 0, __ATOMIC_RELAXED);
+	pondering = pthread_create(&ponder.thread, NULL, helper_search, &ponder) == 0;
+}
+
+// stop pondering when the move of the opponent is known, before the buffers are used again
+void stop_pondering() {
+	if (!pondering) {
+		return;
+	}
+	__atomic_store_n(&search_stopped, 1, __ATOMIC_RELAXED);
+	pthread_join(ponder.thread, NULL);
+	pondering = false;
+
+	// the buffers are shared, but the generations of the breadth first searches went on,
+	// and the killers are those of the pondered position, one ply before the next search
+	search_context = ponder.context;
+	search_context.aborted = false;
+	age_search_context(&search_context, 1);
+
+#ifdef DEBUG
+	TTEntry entry;
+	predicted_hash = 0;
+	if (tt_probe(ponder.game.hash, &entry) && entry.move != 0) {
+		apply_move(&ponder.game, entry.move);
+		predicted_hash = ponder.game.hash;
+		undo_move(&ponder.game, entry.move);
+	}
+#endif
+}
+
+uint64_t game_hash(struct game_state_t game) {
+	size_t positions[2];
+	size_t walls[2];
+	positions[game.self.color] = game.self.pos;
+	positions[game.opponent.color] = game.opponent.pos;
+	walls[game.self.color] = game.self.num_walls;
+	walls[game.opponent.color] = game.opponent.num_walls;
+	return position_hash(game.graph, positions, walls, game.self.color);
+}
+
+// fill the buffers of a compressed game, allocated by init_meta()
+void compress_game(struct game_state_t game, SimpleGameState *compressed) {
+	compressed->pos = game.self.pos == SIZE_MAX ? -1 : (int) game.self.pos;
+	compressed->num_walls = (int) game.self.num_walls;
+	compressed->opponent_pos = game.opponent.pos == SIZE_MAX ? -1 : (int) game.opponent.pos;
+	compressed->opponent_num_walls = (int) game.opponent.num_walls;
+	compressed->start_pos = start_pos;
+	compressed->opponent_start_pos = opponent_start_pos;
+	compressed->target_is_up = target_is_up;
+	compressed->width = n;
+	compressed->color = self_color;
+
+	memcpy(compressed->cells, game.graph->cells, n2);
+	wall_slots_copy(compressed->slots, game.graph->wall_slots);
+	compressed->hash = game_hash(game);
+}
+
+// packed wall of two edges: its head is the smallest of their vertices, and a horizontal wall cuts edges going down
+unsigned pack_wall(const struct edge_t e[2]) {
+	size_t ends[4] = {e[0].fr, e[0].to, e[1].fr, e[1].to};
+	size_t head = ends[0];
+	for (int i = 1; i < 4; ++i) {
+		if (ends[i] < head) {
+			head = ends[i];
+		}
+	}
+	bool horizontal = e[0].fr + (size_t) n == e[0].to || e[0].to + (size_t) n == e[0].fr;
+	return WALL_MOVE(head, horizontal);
+}
+
+// apply the move of the opponent to the compressed game, in the position after the move of the player,
+// return false if the result is not the real position
+bool update_game(struct game_state_t game, SimpleGameState *compressed) {
+	unsigned move;
+
+	if ((int) game.opponent.num_walls == compressed->num_walls - 1) {
+		if (game.previous_move.t != WALL) {
+			return false;
 		}
+		move = pack_wall(game.previous_move.e);
+	} else {
+		int opponent_pos = game.opponent.pos == SIZE_MAX ? -1 : (int) game.opponent.pos;
+		move = DISPLACEMENT_MOVE(opponent_pos - compressed->pos);
 	}
 
-	return compressed;
+	apply_move(compressed, move);
+	return compressed->hash == game_hash(game);
 }
 
 struct move_t expand_move(struct game_state_t game, unsigned move) {
-	enum movetype_t move_type = move >> 24;
-	int embed_int = (int) (move & 0x8000 ? move | 0xFFFF0000 : move & 0xFFFF);
-	bool embed_bool = move >> 16 & 0xFF;
+	enum movetype_t move_type = MOVE_TYPE(move);
+	int embed_int = MOVE_VALUE(move);
+	bool embed_bool = MOVE_HORIZONTAL(move);
 
 	struct move_t expanded = {
 			.c = game.self.color,
@@ -493,22 +1129,303 @@ struct move_t expand_move(struct game_state_t game, unsigned move) {
 	return expanded;
 }
 
+void reset_search_counters(SearchContext *context) {
+	context->nodes = 0;
+	context->tt_probes = 0;
+	context->tt_hits = 0;
+	context->cutoffs = 0;
+	context->first_move_cutoffs = 0;
+}
+
+// open the telemetry stream, a file descriptor if the setting is a number, else a file, which is appended
+void open_telemetry(const char *setting) {
+	char *end;
+	long fd = strtol(setting, &end, 10);
+	if (*setting != '\0' && *end == '\0') {
+		int copy = dup((int) fd);
+		telemetry = copy != -1 ? fdopen(copy, "a") : NULL;
+	} else {
+		telemetry = fopen(setting, "a");
+	}
+
+	if (telemetry == NULL) {
+		fprintf(stderr, "Geralt: can't open the telemetry stream %s\n", setting);
+	}
+}
+
+// a ratio of the telemetry, null without any event to count
+void write_rate(const char *key, uint64_t count, uint64_t total) {
+	if (total == 0) {
+		fprintf(telemetry, ",\"%s\":null", key);
+	} else {
+		fprintf(telemetry, ",\"%s\":%.3f", key, (double) count / (double) total);
+	}
+}
+
+// principal variation, from the move played followed by the moves of the table, as long as they can be played:
+// "m" and the vertex reached for a pawn move, "h" or "v" and the head of a wall for a horizontal or vertical one
+void write_principal_variation(SimpleGameState *game, unsigned best_move) {
+	unsigned pv[MAX_PLY];
+	int length = 0;
+	unsigned move = best_move;
+	TTEntry entry;
+
+	while (move != 0 && length < last_search.depth && length < MAX_PLY && !is_game_terminated(game)) {
+		int value = MOVE_VALUE(move);
+		bool horizontal = MOVE_HORIZONTAL(move);
+		bool playable = MOVE_TYPE(move) == WALL
+				? game->num_walls > 0 && value >= 0 && value < n2 && game->slots->free[horizontal ? HORIZONTAL : VERTICAL][value / 64] >> (value % 64) & 1
+				: game->pos + value >= 0 && game->pos + value < n2;
+		if (!playable) {
+			break;
+		}
+
+		fprintf(telemetry, "%s\"", length > 0 ? "," : "");
+		if (MOVE_TYPE(move) == WALL) {
+			fprintf(telemetry, "%c%d\"", horizontal ? 'h' : 'v', value);
+		} else {
+			fprintf(telemetry, "m%d\"", game->pos + value);
+		}
+		apply_move(game, move);
+		pv[length++] = move;
+		move = tt_probe(game->hash, &entry) ? entry.move : 0;
+	}
+
+	while (length > 0) {
+		undo_move(game, pv[--length]);
+	}
+}
+
+// one line of JSON with the search of the move played, before it is applied to the game
+void write_telemetry(SimpleGameState *game, unsigned best_move, long elapsed) {
+	SearchContext totals = search_context;
+	for (int i = 0; i < nb_of_threads - 1; ++i) {
+		totals.nodes += helpers[i].context.nodes;
+		totals.tt_probes += helpers[i].context.tt_probes;
+		totals.tt_hits += helpers[i].context.tt_hits;
+		totals.cutoffs += helpers[i].context.cutoffs;
+		totals.first_move_cutoffs += helpers[i].context.first_move_cutoffs;
+	}
+
+	fprintf(telemetry, "{\"move\":%d,\"color\":\"%s\",\"depth\":%d,\"score\":%d", moves_played,
+			self_color == BLACK ? "black" : "white", last_search.depth, last_search.score);
+	fprintf(telemetry, ",\"nodes\":%llu,\"nps\":%llu", (unsigned long long) totals.nodes,
+			(unsigned long long) (totals.nodes * 1000 / (uint64_t) (elapsed > 0 ? elapsed : 1)));
+	write_rate("ebf", last_search.iteration_nodes[1], last_search.iteration_nodes[0]);
+	fprintf(telemetry, ",\"cutoffs\":%llu", (unsigned long long) totals.cutoffs);
+	write_rate("first_move_cutoff_rate", totals.first_move_cutoffs, totals.cutoffs);
+	write_rate("tt_hit_rate", totals.tt_hits, totals.tt_probes);
+	fprintf(telemetry, ",\"time_ms\":%ld,\"budget_ms\":%ld,\"hard_limit_ms\":%ld,\"pv\":[",
+			elapsed, last_search.budget, last_search.hard_limit);
+	write_principal_variation(game, best_move);
+	fprintf(telemetry, "]}\n");
+	fflush(telemetry);
+}
+
+// move on a board too large to be searched: a pawn move to the closest vertex to the target line
+struct move_t make_fallback_move(struct game_state_t game) {
+	if (game.self.pos == SIZE_MAX) {
+		return make_default_first_move(game);
+	}
+
+	size_t *field = malloc(game.graph->num_vertices * sizeof(size_t));
+	distance_field(game.graph, game.self.color, field);
+	size_t destinations[MAX_PAWN_MOVE];
+	get_pawn_moves(game.graph, game.self.pos, game.opponent.pos, destinations);
+
+	size_t best = no_vertex();
+	for (int i = 0; i < MAX_PAWN_MOVE; ++i) {
+		if (!is_no_vertex(destinations[i]) && (is_no_vertex(best) || field[destinations[i]] < field[best])) {
+			best = destinations[i];
+		}
+	}
+	free(field);
+
+	return (struct move_t) {
+			.m = best,
+			.e = {no_edge(), no_edge()},
+			.t = MOVE,
+			.c = game.self.color
+	};
+}
+
 struct move_t make_move(struct game_state_t game) {
-	SimpleGameState compressed_game = compress_game(game);
-	unsigned best_move = search_best_move(&compressed_game);
-	free(compressed_game.graph);
+	if (board_too_large) {
+		return make_fallback_move(game);
+	}
+
+	bool pondered = pondering;
+	stop_pondering();
+	++tt_generation;
+	if (!pondered) {
+		age_search_context(&search_context, 2);
+	}
+	reset_search_counters(&search_context);
+	for (int i = 0; i < nb_of_threads - 1; ++i) {
+		age_search_context(&helpers[i].context, 2);
+		helpers[i].context.aborted = false;
+		reset_search_counters(&helpers[i].context);
+	}
+	search_context.aborted = false;
+#ifdef DEBUG
+	size_t nb_of_allocations_before = nb_of_allocations;
+#endif
+
+	long start = get_time();
+	if (!compressed_game_valid || !update_game(game, &compressed_game)) {
+		compress_game(game, &compressed_game);
+		compressed_game_valid = true;
+	}
+	unsigned best_move = search_best_move(&search_context, &compressed_game);
+	long elapsed = get_time() - start;
+	time_used += elapsed;
+	++moves_played;
+	if (telemetry != NULL) {
+		write_telemetry(&compressed_game, best_move, elapsed);
+	}
+
+#ifdef DEBUG
+	uint64_t nodes = search_context.nodes;
+	for (int i = 0; i < nb_of_threads - 1; ++i) {
+		nodes += helpers[i].context.nodes;
+	}
+	printf("(allocations: %zu, nodes: %llu", nb_of_allocations - nb_of_allocations_before, (unsigned long long) nodes);
+	if (ponder_enabled) {
+		printf(", ponder %s", compressed_game.hash == predicted_hash ? "hit" : "miss");
+	}
+	printf(")");
+#endif
+
+	apply_move(&compressed_game, best_move);
+	if (ponder_enabled) {
+		start_pondering();
+	}
 	return expand_move(game, best_move);
 }
 
+// buffers of a search, a ply has at most every wall and every pawn move, or every start position
+void alloc_search_context(SearchContext *context) {
+	*context = (SearchContext) {
+		.moves = ALLOCATE((size_t) search_plies * max_moves_per_ply * sizeof(unsigned)),
+		.scores = ALLOCATE((size_t) search_plies * max_moves_per_ply * sizeof(int)),
+		.marks = ALLOCATE((size_t) search_plies * 2 * n2),
+		.fields.buffers = ALLOCATE((size_t) search_plies * 2 * n2 * sizeof(uint16_t)),
+		.queue = ALLOCATE(n2 * sizeof(int)),
+		.history = (COUNT_ALLOCATION(), calloc(history_size, sizeof(int)))
+	};
+	context->fields.queue = context->queue;
+	COUNT_ALLOCATION();
+	race_table_init(&context->races, RACE_TABLE_BITS);
+	for (int i = 0; i < 2; ++i) {
+		context->bfs[i] = (BfsBuffer) {
+			.stamped = (COUNT_ALLOCATION(), calloc(n2, sizeof(unsigned))),
+			.base = 0
+		};
+	}
+}
+
+void free_search_context(SearchContext *context) {
+	free(context->moves);
+	free(context->scores);
+	free(context->marks);
+	free(context->fields.buffers);
+	free(context->queue);
+	free(context->history);
+	race_table_free(&context->races);
+	for (int i = 0; i < 2; ++i) {
+		free(context->bfs[i].stamped);
+	}
+}
+
+void alloc_game(SimpleGameState *game) {
+	game->cells = ALLOCATE(n2);
+	COUNT_ALLOCATION();
+	game->slots = wall_slots_alloc(n);
+}
+
+void free_game(SimpleGameState *game) {
+	free(game->cells);
+	wall_slots_free(game->slots);
+}
+
+bool env_flag(const char *variable, bool default_value) {
+	char *value = getenv(variable);
+	return value != NULL ? atoi(value) > 0 : default_value;
+}
+
 void init_meta(struct game_state_t state) {
-	n  = (int) sqrtl(state.graph->t->size1);
-	n2 = (int) state.graph->t->size1;
-	n4 = n2 * n2;
+	n  = (int) state.graph->width;
+	n2 = (int) state.graph->num_vertices;
+	self_color = state.self.color;
+
+	board_too_large = n > GERALT_MAX_WIDTH;
+	if (board_too_large) {
+		fprintf(stderr, "Geralt: boards wider than %d vertices can't be searched, the pawn follows a shortest path\n", GERALT_MAX_WIDTH);
+		return;
+	}
+
+	// the size of the transposition table can be set in megabytes with GERALT_TT_MB
+	char *tt_megabytes = getenv("GERALT_TT_MB");
+	tt_init(tt_megabytes != NULL && atoi(tt_megabytes) > 0 ? (size_t) atoi(tt_megabytes) : TT_DEFAULT_MB);
+
+	char *extra = getenv("GERALT_EXTRA_WALLS");
+	extra_walls = extra != NULL && atoi(extra) >= 0 ? atoi(extra) : DEFAULT_EXTRA_WALLS;
+
+	// the number of search threads can be set with GERALT_THREADS, 0 for one per core
+	char *threads = getenv("GERALT_THREADS");
+	nb_of_threads = threads != NULL && atoi(threads) >= 0 ? atoi(threads) : 1;
+	if (nb_of_threads == 0) {
+		nb_of_threads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+	}
+	if (nb_of_threads < 1) {
+		nb_of_threads = 1;
+	}
+
+	// the table of the pawn moves is filled on its first use, which must not happen in two threads at once
+	pawn_moves_lookup(0, 0, NO_DIRECTION);
 
-	start_pos = malloc(sizeof(int) * n);
+	char *depth = getenv("GERALT_DEPTH");
+	fixed_depth = depth != NULL && atoi(depth) > 0 ? atoi(depth) : 0;
+
+	char *time = getenv("GERALT_GAME_TIME");
+	game_time = time != NULL && atol(time) > 0 ? atol(time) : DEFAULT_GAME_TIME;
+	time_used = 0;
+	compressed_game_valid = false;
+
+	use_pvs = env_flag("GERALT_PVS", true);
+	use_aspiration = env_flag("GERALT_ASPIRATION", false);
+	use_lmr = env_flag("GERALT_LMR", true);
+	use_null_move = env_flag("GERALT_NULL_MOVE", true);
+	use_race_solver = env_flag("GERALT_RACE", true);
+
+	char *telemetry_setting = getenv("GERALT_TELEMETRY");
+	telemetry = NULL;
+	moves_played = 0;
+	if (telemetry_setting != NULL) {
+		open_telemetry(telemetry_setting);
+	}
+
+	char *ponder_setting = getenv("GERALT_PONDER");
+	ponder_enabled = ponder_setting != NULL && atoi(ponder_setting) > 0;
+
+	// one entry per wall, then one per pawn move offset
+	history_size = 2 * n2 + 4 * n + 1;
+	max_moves_per_ply = 2 * (n - 1) * (n - 1) + MAX_PAWN_MOVE;
+	search_plies = MAX_MOVE_ENTRIES / max_moves_per_ply < MAX_PLY ? MAX_MOVE_ENTRIES / max_moves_per_ply : MAX_PLY;
+	alloc_search_context(&search_context);
+	alloc_game(&compressed_game);
+
+	helpers = ALLOCATE((nb_of_threads - 1) * sizeof(SearchThread));
+	for (int i = 0; i < nb_of_threads - 1; ++i) {
+		alloc_search_context(&helpers[i].context);
+		alloc_game(&helpers[i].game);
+		helpers[i].first_depth = 1 + (i + 1) % 2;
+	}
+
+	start_pos = ALLOCATE(sizeof(int) * n);
 	nb_of_start_pos = 0;
 
-	opponent_start_pos = malloc(sizeof(int) * n);
+	opponent_start_pos = ALLOCATE(sizeof(int) * n);
 	int nb_of_opponent_start_pos = 0;
 
 	for (int i = 0; i < 2; ++i) {
@@ -516,9 +1433,9 @@ void init_meta(struct game_state_t state) {
 			int pos = j;
 			if (i) pos += n2 - n;
 
-			if (gsl_spmatrix_uint_get(state.graph->o, state.self.color, pos)) {
+			if (is_owned(state.graph, state.self.color, pos)) {
 				start_pos[nb_of_start_pos++] = pos;
-			} else if (gsl_spmatrix_uint_get(state.graph->o, state.opponent.color, pos)) {
+			} else if (is_owned(state.graph, state.opponent.color, pos)) {
 				opponent_start_pos[nb_of_opponent_start_pos++] = pos;
 			}
 		}
@@ -528,11 +1445,6 @@ void init_meta(struct game_state_t state) {
 		exit(EXIT_FAILURE);
 	}
 
-	if (nb_of_start_pos < n) {
-		start_pos = realloc(start_pos, sizeof(int) * nb_of_start_pos);
-		opponent_start_pos = realloc(opponent_start_pos, sizeof(int) * nb_of_start_pos);
-	}
-
 	target_is_up = start_pos[0] >= n;
 }
 
@@ -542,6 +1454,25 @@ struct move_t make_first_move(struct game_state_t game) {
 }
 
 void finalize_ia() {
+	if (board_too_large) {
+		return;
+	}
+
+	stop_pondering();
+	if (telemetry != NULL) {
+		fclose(telemetry);
+	}
+
 	free(start_pos);
 	free(opponent_start_pos);
+	free(tt);
+
+	free_search_context(&search_context);
+	free_game(&compressed_game);
+
+	for (int i = 0; i < nb_of_threads - 1; ++i) {
+		free_search_context(&helpers[i].context);
+		free_game(&helpers[i].game);
+	}
+	free(helpers);
 }
@@ -0,0 +1,117 @@
+#include "geralt.h"
+
+void invert_int(int *a, int *b) {
+	int tmp = *a;
+	*a = *b;
+	*b = tmp;
+}
+
+void invert_ptr(int **a, int **b) {
+	int *tmp = *a;
+	*a = *b;
+	*b = tmp;
+}
+
+void change_side(SimpleGameState *game) {
+	invert_int(&game->pos, &game->opponent_pos);
+	invert_int(&game->num_walls, &game->opponent_num_walls);
+	invert_ptr(&game->start_pos, &game->opponent_start_pos);
+	game->target_is_up = !game->target_is_up;
+	game->color = 1 - game->color;
+}
+
+// pass the turn, only done by the null move pruning, a second call restores the game
+void null_move(SimpleGameState *game) {
+	change_side(game);
+	game->hash ^= zobrist_side();
+}
+
+// direction of the opponent if it stands next to the player to move, whether a wall is between them or not
+static enum direction_t opponent_direction(const SimpleGameState *state) {
+	int n = state->width;
+	int player_pos = state->pos;
+	int opponent_pos = state->opponent_pos;
+
+	if (opponent_pos == -1) {
+		return NO_DIRECTION;
+	}
+	if (opponent_pos + n == player_pos) {
+		return NORTH;
+	}
+	if (player_pos + n == opponent_pos) {
+		return SOUTH;
+	}
+	if (opponent_pos + 1 == player_pos && player_pos % n != 0) {
+		return WEST;
+	}
+	if (player_pos + 1 == opponent_pos && opponent_pos % n != 0) {
+		return EAST;
+	}
+	return NO_DIRECTION;
+}
+
+void add_displacement_moves(const SimpleGameState *state, unsigned *moves, int *nb_of_moves) {
+	enum direction_t direction = opponent_direction(state);
+	uint16_t legal = pawn_moves_lookup(state->cells[state->pos], direction == NO_DIRECTION ? 0 : state->cells[state->opponent_pos], direction);
+
+	while (legal) {
+		enum pawn_move_t move = __builtin_ctz(legal);
+		legal &= legal - 1;
+		moves[(*nb_of_moves)++] = DISPLACEMENT_MOVE((int) pawn_move_offset((size_t) state->width, move));
+	}
+}
+
+// the flags of a wall, which are not set before it is placed, so the same xor places and removes it
+static void toggle_wall(SimpleGameState *state, int corner, bool horizontal) {
+	int n = state->width;
+
+	if (horizontal) {
+		state->cells[corner] ^= CLOSED_SOUTH | WALL_HEAD_SOUTH;
+		state->cells[corner + 1] ^= CLOSED_SOUTH;
+		state->cells[corner + n] ^= CLOSED_NORTH;
+		state->cells[corner + n + 1] ^= CLOSED_NORTH;
+	} else {
+		state->cells[corner] ^= CLOSED_EAST | WALL_HEAD_EAST;
+		state->cells[corner + n] ^= CLOSED_EAST;
+		state->cells[corner + 1] ^= CLOSED_WEST;
+		state->cells[corner + n + 1] ^= CLOSED_WEST;
+	}
+}
+
+// play (direction 1) or take back (direction -1) a move of the player to move
+static void update_player(SimpleGameState *state, unsigned move, int direction) {
+	int value = MOVE_VALUE(move);
+	state->hash ^= zobrist_side();
+
+	if (MOVE_TYPE(move) == MOVE) {
+		state->hash ^= zobrist_pawn(state->color, (size_t) state->pos);
+		state->pos += direction * value;
+		state->hash ^= zobrist_pawn(state->color, (size_t) state->pos);
+		return;
+	}
+
+	bool horizontal = MOVE_HORIZONTAL(move);
+	size_t wall = (size_t) value * 2 + !horizontal;
+
+	state->hash ^= zobrist_walls_left(state->color, state->num_walls);
+	state->num_walls -= direction;
+	state->hash ^= zobrist_walls_left(state->color, state->num_walls);
+	state->hash ^= zobrist_key(ZOBRIST_WALL, wall);
+
+	toggle_wall(state, value, horizontal);
+	if (direction > 0) {
+		wall_slots_place(state->slots, wall);
+	} else {
+		wall_slots_remove(state->slots, wall);
+	}
+}
+
+void apply_move(SimpleGameState *state, unsigned move) {
+	update_player(state, move, 1);
+	change_side(state);
+}
+
+void undo_move(SimpleGameState *state, unsigned move) {
+	change_side(state);
+	update_player(state, move, -1);
+}
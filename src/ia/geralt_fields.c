@@ -0,0 +1,90 @@
+#include <string.h>
+
+#include "geralt.h"
+
+void compute_goal_field(const SimpleGameState *game, enum color_t color, uint16_t *field, int *queue) {
+	int n = game->width;
+	int n2 = n * n;
+	bool current_target_is_up = (color == game->color) == game->target_is_up;
+	const int offsets[MAX_DIRECTION] = {0, -n, n, -1, 1};
+
+	memset(field, 0xFF, n2 * sizeof(uint16_t));
+	for (int i = 0; i < n; ++i) {
+		queue[i] = current_target_is_up ? i : n2 - n + i;
+		field[queue[i]] = 0;
+	}
+
+	int size = n;
+	for (int head = 0; head < size; ++head) {
+		int current_pos = queue[head];
+		for (enum direction_t d = NORTH; d <= EAST; ++d) {
+			int new_pos = current_pos + offsets[d];
+			if (!(game->cells[current_pos] & 1 << d) && field[new_pos] == UNREACHABLE) {
+				field[new_pos] = field[current_pos] + 1;
+				queue[size++] = new_pos;
+			}
+		}
+	}
+}
+
+static inline bool has_closer_neighbor(const SimpleGameState *game, const uint16_t *field, int pos) {
+	int n = game->width;
+	const int offsets[MAX_DIRECTION] = {0, -n, n, -1, 1};
+
+	for (enum direction_t d = NORTH; d <= EAST; ++d) {
+		if (!(game->cells[pos] & 1 << d) && field[pos + offsets[d]] == field[pos] - 1) {
+			return true;
+		}
+	}
+	return false;
+}
+
+// each vertex which lost a neighbor closer to the target line must still have another one
+bool wall_keeps_field(const SimpleGameState *game, const uint16_t *field, int corner, bool horizontal) {
+	int step = horizontal ? game->width : 1;
+	int side = horizontal ? 1 : game->width;
+	int ends[4] = {corner, corner + step, corner + side, corner + side + step};
+
+	// the closed edges are (ends[0], ends[1]) and (ends[2], ends[3])
+	for (int i = 0; i < 4; ++i) {
+		int u = ends[i];
+		if (field[ends[i ^ 1]] == field[u] - 1 && !has_closer_neighbor(game, field, u)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+void reset_goal_fields(GoalFields *fields) {
+	for (enum color_t color = BLACK; color <= WHITE; ++color) {
+		fields->owner[0][color] = 0;
+		fields->ready[0][color] = false;
+	}
+}
+
+static inline uint16_t *field_buffer(const GoalFields *fields, const SimpleGameState *game, int ply, enum color_t color) {
+	return fields->buffers + (size_t) (2 * ply + color) * game->width * game->width;
+}
+
+// the field is computed in the buffers of the ply which holds it, whose walls are the same as the ones of the game
+const uint16_t *goal_field(GoalFields *fields, const SimpleGameState *game, int ply, enum color_t color) {
+	int owner = fields->owner[ply][color];
+	if (!fields->ready[owner][color]) {
+		compute_goal_field(game, color, field_buffer(fields, game, owner, color), fields->queue);
+		fields->ready[owner][color] = true;
+	}
+	return field_buffer(fields, game, owner, color);
+}
+
+// a wall is only checked against a ready field, the others get the buffers of the next ply
+void update_goal_fields(GoalFields *fields, const SimpleGameState *game, int ply, unsigned move) {
+	for (enum color_t color = BLACK; color <= WHITE; ++color) {
+		int owner = fields->owner[ply][color];
+		if (MOVE_TYPE(move) == WALL && !(fields->ready[owner][color]
+				&& wall_keeps_field(game, field_buffer(fields, game, owner, color), MOVE_VALUE(move), MOVE_HORIZONTAL(move)))) {
+			owner = ply + 1;
+			fields->ready[owner][color] = false;
+		}
+		fields->owner[ply + 1][color] = owner;
+	}
+}
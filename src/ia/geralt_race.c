@@ -0,0 +1,154 @@
+#include <limits.h>
+#include <stdlib.h>
+
+#include "geralt.h"
+
+// longest race searched, and nodes searched by a call of solve_race() before it gives up
+#define RACE_MAX_PLIES 200
+#define RACE_NODE_LIMIT 4096
+// budget of the races given up, above every budget searched
+#define RACE_GIVEN_UP UINT8_MAX
+
+void race_table_init(RaceTable *table, int bits) {
+	table->entries = calloc((size_t) 1 << bits, sizeof(RaceEntry));
+	table->mask = ((size_t) 1 << bits) - 1;
+	table->nodes = 0;
+}
+
+void race_table_free(RaceTable *table) {
+	free(table->entries);
+}
+
+// result of a race in which the pawns are too far apart to meet before one of them arrives:
+// until they are next to each other, a pawn moves by one vertex, so their gap closes by at most one
+// vertex a ply, and nothing stops the player who is ahead from following its field, the player to move
+// arrives at ply 2 * dist - 1 and the opponent at ply 2 * opponent_dist
+static enum race_result_t race_bound(const SimpleGameState *state, const uint16_t *fields[2], int *plies) {
+	int n = state->width;
+	int dist = fields[state->color][state->pos];
+	int opponent_dist = fields[1 - state->color][state->opponent_pos];
+	int gap = abs(state->pos % n - state->opponent_pos % n) + abs(state->pos / n - state->opponent_pos / n);
+
+	if (opponent_dist == 0) {
+		*plies = 0;
+		return RACE_LOSS;
+	}
+	if (dist == 0) {
+		*plies = 0;
+		return RACE_WIN;
+	}
+	if (dist <= opponent_dist && gap >= 2 * dist) {
+		*plies = 2 * dist - 1;
+		return RACE_WIN;
+	}
+	if (dist > opponent_dist && gap > 2 * opponent_dist) {
+		*plies = 2 * opponent_dist;
+		return RACE_LOSS;
+	}
+	return RACE_UNKNOWN;
+}
+
+// sort the pawn moves by the distance they leave to the player to move, the fastest wins are searched first
+static void order_race_moves(const SimpleGameState *state, const uint16_t *field, unsigned *moves, int nb_of_moves) {
+	for (int i = 1; i < nb_of_moves; ++i) {
+		unsigned move = moves[i];
+		int dist = field[state->pos + MOVE_VALUE(move)];
+		int j = i;
+		for (; j > 0 && field[state->pos + MOVE_VALUE(moves[j - 1])] > dist; --j) {
+			moves[j] = moves[j - 1];
+		}
+		moves[j] = move;
+	}
+}
+
+// minimax of the pawn moves on at most budget plies, the player to move wins by the fastest move
+// after which the opponent loses, and loses by the slowest move if the opponent wins after all of them,
+// a solved race is exact whatever the budget, so it is kept in the table with the budget of an unsolved one
+static enum race_result_t race_search(RaceTable *table, SimpleGameState *state, const uint16_t *fields[2], int budget, int *plies) {
+	enum race_result_t result = race_bound(state, fields, plies);
+	if (result != RACE_UNKNOWN || budget == 0) {
+		return result;
+	}
+
+	RaceEntry *entry = &table->entries[state->hash & table->mask];
+	if (entry->key == state->hash && (entry->result != RACE_UNKNOWN || entry->budget >= budget)) {
+		*plies = entry->plies;
+		return entry->result;
+	}
+	if (--table->nodes < 0) {
+		return RACE_UNKNOWN;
+	}
+
+	unsigned moves[MAX_PAWN_MOVE];
+	int nb_of_moves = 0;
+	add_displacement_moves(state, moves, &nb_of_moves);
+	order_race_moves(state, fields[state->color], moves, nb_of_moves);
+
+	// once a win is found, the next moves are only searched for a faster one
+	int win_plies = INT_MAX;
+	int loss_plies = 0;
+	bool unsolved = nb_of_moves == 0;
+	for (int i = 0; i < nb_of_moves && win_plies > 1; ++i) {
+		int child_budget = win_plies - 2 < budget - 1 ? win_plies - 2 : budget - 1;
+		int child_plies;
+		apply_move(state, moves[i]);
+		enum race_result_t child = race_search(table, state, fields, child_budget, &child_plies);
+		undo_move(state, moves[i]);
+
+		if (child == RACE_LOSS && child_plies + 1 < win_plies) {
+			win_plies = child_plies + 1;
+		} else if (child == RACE_WIN && child_plies + 1 > loss_plies) {
+			loss_plies = child_plies + 1;
+		} else if (child == RACE_UNKNOWN) {
+			unsolved = true;
+		}
+	}
+
+	// a win through an unsolved move would be longer than the budget, so longer than the one found
+	if (win_plies != INT_MAX) {
+		result = RACE_WIN;
+		*plies = win_plies;
+	} else if (!unsolved) {
+		result = RACE_LOSS;
+		*plies = loss_plies;
+	}
+
+	// a race left unsolved because the search ran out of nodes may be solved with the same budget
+	if (result != RACE_UNKNOWN || table->nodes >= 0) {
+		*entry = (RaceEntry) {
+			.key = state->hash,
+			.plies = result != RACE_UNKNOWN ? *plies : 0,
+			.result = result,
+			.budget = budget
+		};
+	}
+	return result;
+}
+
+enum race_result_t solve_race(RaceTable *table, SimpleGameState *state, const uint16_t *fields[2], int *plies) {
+	int dist = fields[state->color][state->pos];
+	int opponent_dist = fields[1 - state->color][state->opponent_pos];
+	if (dist == UNREACHABLE || opponent_dist == UNREACHABLE) {
+		return RACE_UNKNOWN;
+	}
+
+	// when both players have run their distance, the race is over unless one of them blocked the other
+	int budget = 2 * (dist + opponent_dist);
+	if (budget > RACE_MAX_PLIES) {
+		budget = RACE_MAX_PLIES;
+	}
+
+	table->nodes = RACE_NODE_LIMIT;
+	enum race_result_t result = race_search(table, state, fields, budget, plies);
+
+	// a race which can't be solved with the nodes of a call is not searched again
+	if (result == RACE_UNKNOWN && table->nodes < 0) {
+		table->entries[state->hash & table->mask] = (RaceEntry) {
+			.key = state->hash,
+			.plies = 0,
+			.result = RACE_UNKNOWN,
+			.budget = RACE_GIVEN_UP
+		};
+	}
+	return result;
+}
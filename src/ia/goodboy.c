@@ -5,6 +5,7 @@
 #include <stdio.h>
 
 char* name = "Good Boy";
+bool board_read_only = true;
 
 struct move_t make_first_move(struct game_state_t game) {
 	return make_default_first_move(game);
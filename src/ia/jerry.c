@@ -4,6 +4,7 @@
 #include "move.h"
 
 char* name = "Jerry";
+bool board_read_only = true;
 
 // Move to the closest vertex to the finish
 size_t move_forward(struct game_state_t game) {
@@ -4,12 +4,13 @@
 #include "move.h"
 
 char* name = "Jump";
+bool board_read_only = true;
 
 // Move to the closest vertex to the finish
 size_t move_forward(struct game_state_t game) {
 
 	enum direction_t GOAL = game.self.color == BLACK ? SOUTH : NORTH;
-    size_t pos = GOAL == SOUTH ? game.self.pos + 2*sqrt(game.graph->num_vertices) : game.self.pos - 2*sqrt(game.graph->num_vertices) ;
+    size_t pos = GOAL == SOUTH ? game.self.pos + 2*game.graph->width : game.self.pos - 2*game.graph->width ;
 
     return pos;
 }
@@ -7,6 +7,9 @@
  * - board size (-m): a positive integer representing the width of the board
  * - board shape (-t): a character representing the board shape,
  * available shapes are `c` (SQUARE), `t` (TORIC), `h` (H), `s` (SNAKE)
+ * - number of games (-g): a positive integer, the games are played in a row by the same process
+ * - shared board (-s): the players exporting `initialize_shared()` read the board of the server
+ * - turn limit (-l): a positive integer, the game is a draw after this number of turns
  */
 
 #include "opt.h"
@@ -19,6 +22,9 @@
 
 int board_size = -1;
 enum shape_t board_shape = INVALID_SHAPE;
+int num_games = -1;
+bool shared_board = false;
+int max_turns = -1;
 char *player_1_path = NULL;
 char *player_2_path = NULL;
 
@@ -33,7 +39,7 @@ void usage(char *exec_path, char *message) {
 	if (message != NULL) {
 		fprintf(stderr, "%s\n\n", message);
 	}
-	fprintf(stderr, "Usage: %s [-m SIZE] [-t SHAPE] <PLAYER_1_PATH> <PLAYER_2_PATH>\n", exec_path);
+	fprintf(stderr, "Usage: %s [-m SIZE] [-t SHAPE] [-g GAMES] [-s] [-l TURNS] <PLAYER_1_PATH> <PLAYER_2_PATH>\n", exec_path);
 }
 
 /**
@@ -104,6 +110,23 @@ void parse_args(int argc, char **argv) {
 			board_shape = parse_board_shape(argv[++i]);
 			assert(board_shape != INVALID_SHAPE, argv[0], "Board shape must be \"c\", \"t\", \"h\" or \"s\".");
 
+		} else if (strcmp(arg, "-g") == 0) {
+			assert(num_games == -1, argv[0], "\"-g\" option can not be used multiple times.");
+			assert(i + 1 < argc, argv[0], "\"-g\" option must be followed by the number of games.");
+
+			num_games = atoi(argv[++i]);
+			assert(num_games > 0, argv[0], "Number of games must be a strictly positive number.");
+
+		} else if (strcmp(arg, "-s") == 0) {
+			shared_board = true;
+
+		} else if (strcmp(arg, "-l") == 0) {
+			assert(max_turns == -1, argv[0], "\"-l\" option can not be used multiple times.");
+			assert(i + 1 < argc, argv[0], "\"-l\" option must be followed by the number of turns.");
+
+			max_turns = atoi(argv[++i]);
+			assert(max_turns > 0, argv[0], "Turn limit must be a strictly positive number.");
+
 		} else {
 			assert(player_2_path == NULL, argv[0], "There is too much players.");
 
@@ -133,6 +156,10 @@ void parse_args(int argc, char **argv) {
 		board_size = 15;
 	}
 
+	if (num_games == -1) {
+		num_games = 1;
+	}
+
 	switch (board_shape) {
 		case TORIC:
 		case H:
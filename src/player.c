@@ -5,6 +5,15 @@
 struct game_state_t game;
 extern char *name;
 
+/** Set to true by the strategies which never modify `game.graph`, the others need not define it */
+bool board_read_only __attribute__((weak)) = false;
+
+/** Board shared by the server, NULL if the player replays the moves into its own graph */
+static const struct graph_snapshot_t *shared_board = NULL;
+
+/** Version of the shared board when `game.graph` was last synchronized with it */
+static size_t shared_version = 0;
+
 /** 
  * @brief Access to player information
  *  
@@ -43,26 +52,67 @@ void initialize(enum color_t id, struct graph_t *graph, size_t num_walls) {
 			.pos = SIZE_MAX, // default value (no position for now)
 			.num_walls = num_walls
 	};
+
+	game.previous_move = (struct move_t) {
+			.m = no_vertex(),
+			.e = { no_edge(), no_edge() },
+			.t = NO_TYPE,
+			.c = game.opponent.color
+	};
+}
+
+/**
+ * @brief Initialize the player with a board shared by the server
+ * 
+ * @details Preconditions are the ones of `initialize()`, except that
+ * `snapshot` belongs to the server and must not be freed nor modified. \n
+ * If the strategy sets `board_read_only`, `game.graph` is a view of the shared
+ * board, which already holds the walls of both players, with its own search
+ * buffers. Otherwise it is a private clone, into which the walls are replayed,
+ * so that the strategy can still modify it during its searches
+ * 
+ * @param id The color assigned to the player
+ * @param snapshot The board of the server and its version
+ * @param num_walls The number of walls assigned to the player
+ */
+void initialize_shared(enum color_t id, const struct graph_snapshot_t *snapshot, size_t num_walls) {
+	if (board_read_only) {
+		shared_board = snapshot;
+		shared_version = snapshot->version;
+		initialize(id, graph_view(snapshot->graph), num_walls);
+	} else {
+		initialize(id, graph_clone(snapshot->graph), num_walls);
+	}
 }
 
 /** 
  * @brief Update the player graph with the given move
  * 
  * @details Update player position if move is a displacement
- * or place the wall in the current player graph
+ * or place the wall in the current player graph. \n
+ * A view of a shared board is synchronized with it instead, the server
+ * having already placed the walls
  * 
  * @param move The last game move 
  */
 void update_graph(struct move_t move) {
 	struct player_state_t *player = move.c == game.self.color ? &game.self : &game.opponent;
 
+	if (shared_board != NULL && shared_board->version != shared_version) {
+		graph_view_sync(game.graph, shared_board->graph);
+		shared_version = shared_board->version;
+	}
+
 	switch (move.t) {
 		case MOVE:
 			player->pos = move.m;
 			break;
 
 		case WALL:
-			place_wall(game.graph, move.e);
+			// The shared board already holds the walls
+			if (shared_board == NULL) {
+				place_wall(game.graph, move.e);
+			}
 			--player->num_walls;
 			break;
 
@@ -108,6 +158,7 @@ void print_move(struct move_t move) {
  */
 struct move_t play(struct move_t previous_move) {
 	update_graph(previous_move);
+	game.previous_move = previous_move;
 
 	static bool first_move = true;
 	struct move_t move;
@@ -132,5 +183,10 @@ struct move_t play(struct move_t previous_move) {
  */
 void finalize() {
 	finalize_ia();
-	graph_free(game.graph);
+	if (shared_board != NULL) {
+		graph_view_free(game.graph);
+	} else {
+		graph_free(game.graph);
+	}
+	shared_board = NULL;
 }
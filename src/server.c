@@ -1,15 +1,21 @@
+#include "bitboard.h"
 #include "board.h"
 #include "graph.h"
 #include "move.h"
 #include "opt.h"
 #include <dlfcn.h>
+#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 
 extern char* player_1_path;
 extern char* player_2_path;
 extern int board_size;
+extern int num_games;
+extern bool shared_board;
+extern int max_turns;
 
 bool game_over = false;
 size_t position_player_1 = -1;
@@ -17,18 +23,30 @@ size_t position_player_2 = -1;
 enum color_t active_player = -1;
 enum color_t winner = -1;
 size_t turn = 0;
+struct bitboard_t* board_bits = NULL;
+uint64_t board_bits_hash = 0;
+struct graph_snapshot_t board_snapshot = { NULL, 0 };
 
+size_t walls_left[2] = { 0, 0 };
+uint64_t position_key = 0;
+uint64_t* history_keys = NULL;
+uint8_t* history_counts = NULL;
+size_t history_size = 0;
+size_t history_capacity = 0;
 
-enum reasons_t { WIN = 0, INVALID_MOVE = 1 };
+
+enum reasons_t { WIN = 0, INVALID_MOVE = 1, DRAW = 2 };
 
 void* P1_lib;
 void (*P1_initialize)(enum color_t id, struct graph_t* graph, size_t num_walls);
+void (*P1_initialize_shared)(enum color_t id, const struct graph_snapshot_t* snapshot, size_t num_walls);
 char* (*P1_name)(void);
 struct move_t(*P1_play)(struct move_t previous_move);
 void (*P1_finalize)();
 
 void* P2_lib;
 void (*P2_initialize)(enum color_t id, struct graph_t* graph, size_t num_walls);
+void (*P2_initialize_shared)(enum color_t id, const struct graph_snapshot_t* snapshot, size_t num_walls);
 char* (*P2_name)(void);
 struct move_t(*P2_play)(struct move_t previous_move);
 void (*P2_finalize)();
@@ -37,7 +55,8 @@ void (*P2_finalize)();
  * @brief Load players' dynamics librairies
  *
  * @details Load the players' dynamics libraries and stores the adresses
- *  of the symbols declared in the client interface into variables
+ *  of the symbols declared in the client interface into variables.
+ *  `initialize_shared` is optional, its address is NULL if a player does not export it
  */
 void load_libs(void) {
 	P1_lib = dlopen(player_1_path, RTLD_LAZY);
@@ -57,6 +76,8 @@ void load_libs(void) {
 	P1_name = dlsym(P1_lib, "get_player_name");
 	P1_play = dlsym(P1_lib, "play");
 	P1_finalize = dlsym(P1_lib, "finalize");
+	P1_initialize_shared = dlsym(P1_lib, "initialize_shared");
+	dlerror();
 
 	P2_lib = dlopen(player_2_path, RTLD_LAZY);
 	error = dlerror();
@@ -75,6 +96,8 @@ void load_libs(void) {
 	P2_name = dlsym(P2_lib, "get_player_name");
 	P2_play = dlsym(P2_lib, "play");
 	P2_finalize = dlsym(P2_lib, "finalize");
+	P2_initialize_shared = dlsym(P2_lib, "initialize_shared");
+	dlerror();
 }
 
 /**
@@ -90,7 +113,7 @@ void load_libs(void) {
  * @return True if the player is winning, else false
  */
 bool is_winning(struct graph_t* board, enum color_t active_player, size_t position) {
-	return gsl_spmatrix_uint_get(board->o, 1 - active_player, position);
+	return is_owned(board, 1 - active_player, position);
 }
 
 /**
@@ -102,10 +125,65 @@ enum color_t get_next_player(enum color_t player) { return 1 - player; }
 
 
 void end_game(enum reasons_t reason) {
-	winner = reason == WIN ? active_player : get_next_player(active_player);
+	if (reason == DRAW) {
+		winner = NO_COLOR;
+	}
+	else {
+		winner = reason == WIN ? active_player : get_next_player(active_player);
+	}
 	game_over = true;
 }
 
+/**
+ * @brief Add a position to the history of the game
+ *
+ * @details The history is an open addressing hash set of the position keys,
+ * with the number of times each position occurred
+ *
+ * @param key The hash of the position
+ *
+ * @returns The number of times the position occurred, this one included
+ */
+size_t record_position(uint64_t key) {
+	// Keep the load factor under one half
+	if (2 * (history_size + 1) > history_capacity) {
+		uint64_t* old_keys = history_keys;
+		uint8_t* old_counts = history_counts;
+		size_t old_capacity = history_capacity;
+
+		history_capacity = history_capacity == 0 ? 256 : 2 * history_capacity;
+		history_keys = malloc(history_capacity * sizeof(*history_keys));
+		history_counts = calloc(history_capacity, sizeof(*history_counts));
+		history_size = 0;
+		for (size_t i = 0; i < old_capacity; ++i) {
+			if (old_counts[i] > 0) {
+				size_t j = old_keys[i] & (history_capacity - 1);
+				while (history_counts[j] > 0) {
+					j = (j + 1) & (history_capacity - 1);
+				}
+				history_keys[j] = old_keys[i];
+				history_counts[j] = old_counts[i];
+				++history_size;
+			}
+		}
+		free(old_keys);
+		free(old_counts);
+	}
+
+	size_t i = key & (history_capacity - 1);
+	while (history_counts[i] > 0 && history_keys[i] != key) {
+		i = (i + 1) & (history_capacity - 1);
+	}
+	if (history_counts[i] == 0) {
+		history_keys[i] = key;
+		++history_size;
+	}
+	if (history_counts[i] < UINT8_MAX) {
+		++history_counts[i];
+	}
+	return history_counts[i];
+}
+
 /**
  * @brief Check the validity of a displacement
  *
@@ -133,120 +211,30 @@ bool is_valid_displacement(struct graph_t* board, size_t destination, enum color
 		return (board->num_vertices - board_size <= destination) && (destination < board->num_vertices);
 	}
 
-	// Check destination is in the 4 near cells :
-	if (is_linked(board, position_player, destination)) {
-		return true;
-	}
-
-	// Check others destination manually
-	// Move 2 on the left
-	if (position_player % board_size > 1 &&
-		position_player - destination == 2 &&
-		is_linked(board, position_player, position_player - 1) &&
-		is_linked(board, position_player - 1, destination) &&
-		position_opposent == position_player - 1) {
-		return true;
-	}
-
-	// Move 2 on the right
-	if (position_player % board_size < (long unsigned int) board_size - 2 &&
-		destination - position_player == 2 &&
-		is_linked(board, position_player, position_player + 1) &&
-		is_linked(board, position_player + 1, destination) &&
-		position_opposent == position_player + 1) {
-		return true;
-	}
-
-	// Move 2 on the top
-	if (position_player / board_size > 1 &&
-		destination + 2 * board_size == position_player &&
-		is_linked(board, position_player, position_player - board_size) &&
-		is_linked(board, position_player - board_size, destination) &&
-		position_opposent == position_player - board_size) {
-		return true;
-	}
-
-	// Move 2 on the bottom
-	if (position_player / board_size < (long unsigned int) board_size - 2 &&
-		position_player + 2 * board_size == destination &&
-		is_linked(board, position_player, position_player + board_size) &&
-		is_linked(board, position_player + board_size, destination) &&
-		position_opposent == position_player + board_size) {
-		return true;
-	}
-
-	// Move top + left
-	if (position_player / board_size > 0 &&
-		position_player % board_size > 0 &&
-		position_player - board_size == destination + 1 &&
-		(
-			(is_linked(board, position_player, position_player - board_size) &&
-				is_linked(board, position_player - board_size, destination) &&
-				position_opposent == position_player - board_size
-				)
-			||
-			(is_linked(board, position_player, position_player - 1) &&
-				is_linked(board, position_player - 1, destination) &&
-				position_opposent == position_player - 1)
-			)
-		) {
-		return true;
-	}
-
-	// Move top + right
-	if (position_player / board_size > 0 &&
-		position_player % board_size < (long unsigned int) board_size - 1 &&
-		position_player - board_size == destination - 1 &&
-		(
-			(is_linked(board, position_player, position_player - board_size) &&
-				is_linked(board, position_player - board_size, destination) &&
-				position_opposent == position_player - board_size
-				)
-			||
-			(is_linked(board, position_player, position_player + 1) &&
-				is_linked(board, position_player + 1, destination) &&
-				position_opposent == position_player + 1)
-			)
-		) {
-		return true;
-	}
+	// Check destination against the legal steps and jumps
+	return is_pawn_move(board, position_player, position_opposent, destination);
+}
 
-	// Move bot + right
-	if (position_player / board_size < (long unsigned int) board_size - 1 &&
-		position_player % board_size < (long unsigned int) board_size - 1 &&
-		position_player + board_size == destination - 1 &&
-		(
-			(is_linked(board, position_player, position_player + board_size) &&
-				is_linked(board, position_player + board_size, destination) &&
-				position_opposent == position_player + board_size
-				)
-			||
-			(is_linked(board, position_player, position_player + 1) &&
-				is_linked(board, position_player + 1, destination) &&
-				position_opposent == position_player + 1)
-			)
-		) {
-		return true;
+/**
+ * @brief Make the bitboard of the server hold the walls of the board
+ * 
+ * @details The bitboard is only loaded again if it was not kept up to date by
+ * update_board(), which is detected with the hash of the walls of the board
+ * 
+ * @param board The game board
+ */
+void sync_board_bits(const struct graph_t* board) {
+	if (board_bits == NULL || board_bits->num_vertices != board->num_vertices) {
+		if (board_bits != NULL) {
+			bitboard_free(board_bits);
+		}
+		board_bits = bitboard_alloc(board->width);
 	}
-
-	// Move bot + left
-	if (position_player / board_size < (long unsigned int) board_size - 1 &&
-		position_player % board_size > 0 &&
-		position_player + board_size == destination + 1 &&
-		(
-			(is_linked(board, position_player, position_player + board_size) &&
-				is_linked(board, position_player + board_size, destination) &&
-				position_opposent == position_player + board_size
-				)
-			||
-			(is_linked(board, position_player, position_player - 1) &&
-				is_linked(board, position_player - 1, destination) &&
-				position_opposent == position_player - 1)
-			)
-		) {
-		return true;
+	else if (board_bits_hash == board->hash) {
+		return;
 	}
-	return false;
+	bitboard_load(board_bits, board);
+	board_bits_hash = board->hash;
 }
 
 /**
@@ -257,6 +245,9 @@ bool is_valid_displacement(struct graph_t* board, size_t destination, enum color
  * - do not cut a existing wall
  * - do not prevents a player to reach the arrival
  * 
+ * The reachability is checked on the bitboard of the server, kept in sync
+ * with the board, where the wall is closed then opened again
+ * 
  * @param board The game board
  * @param e An array containing two edges representing a wall
  * 
@@ -283,15 +274,15 @@ bool is_valid_wall(struct graph_t* board, struct edge_t e[]) {
 	// Check if vertices form a valid square
 	if ((e0fr % board_size) + 1 == e0to % board_size && (e1fr % board_size) + 1 == e1to % board_size && e0fr + board_size == e1fr) { // vertical wall
 		// Check if the wall cut another wall
-		size_t e2 = gsl_spmatrix_uint_get(board->t, e0fr, e1fr);
-		if (e2 == 7) {
+		size_t e2 = edge_state(board, e0fr, e1fr);
+		if (e2 == HORIZONTAL_WALL_HEAD) {
 			return false;
 		}
 	}
 	else if (e0fr + board_size == e0to && e1fr + board_size == e1to && (e0fr % board_size) + 1 == e1fr % board_size) { // horizontal wall
 		// Check if the wall cut another wall
-		size_t e2 = gsl_spmatrix_uint_get(board->t, e0fr, e1fr);
-		if (e2 == 5) {
+		size_t e2 = edge_state(board, e0fr, e1fr);
+		if (e2 == VERTICAL_WALL_HEAD) {
 			return false;
 		}
 	}
@@ -305,13 +296,14 @@ bool is_valid_wall(struct graph_t* board, struct edge_t e[]) {
 	edge[0].to = e0to;
 	edge[1].fr = e1fr;
 	edge[1].to = e1to;
-	place_wall(board, edge);
-	if (dijkstra(board, position_player_1, BLACK) == IMPOSSIBLE_DISTANCE || dijkstra(board, position_player_2, WHITE) == IMPOSSIBLE_DISTANCE) {
-		remove_wall(board, edge);
-		return false;
+	if (!wall_may_disconnect(board, edge)) {
+		return true;
 	}
-	remove_wall(board, edge);
-	return true;
+	sync_board_bits(board);
+	bitboard_close_wall(board_bits, edge);
+	bool reachable = bitboard_can_reach(board_bits, position_player_1, BLACK) && bitboard_can_reach(board_bits, position_player_2, WHITE);
+	bitboard_open_wall(board_bits, edge);
+	return reachable;
 }
 
 /**
@@ -381,67 +373,87 @@ void update_board(struct graph_t* board, struct move_t* last_move) {
 	// Update players positions if they move
 	if (last_move->t == MOVE) {
 		if (active_player == BLACK) {
+			position_key ^= zobrist_pawn(BLACK, position_player_1) ^ zobrist_pawn(BLACK, last_move->m);
 			position_player_1 = last_move->m;
 		}
 		else {
+			position_key ^= zobrist_pawn(WHITE, position_player_2) ^ zobrist_pawn(WHITE, last_move->m);
 			position_player_2 = last_move->m;
 		}
 	}
 	else {
 		// Update the board if a player has put a wall
+		uint64_t walls_hash = board->hash;
+		sync_board_bits(board);
 		place_wall(board, last_move->e);
+		bitboard_close_wall(board_bits, last_move->e);
+		board_bits_hash = board->hash;
+		board_snapshot.version++;
+
+		position_key ^= walls_hash ^ board->hash;
+		if (walls_left[active_player] > 0) {
+			position_key ^= zobrist_walls_left(active_player, walls_left[active_player]);
+			--walls_left[active_player];
+			position_key ^= zobrist_walls_left(active_player, walls_left[active_player]);
+		}
 	}
+
+	// The other player is the next to move
+	position_key ^= zobrist_side();
 }
 
 /**
  * @brief Free all allocated memory during the game
  * 
- * @details Finalize the two players, free the board and then close the dynamic librairies
+ * @details Finalize the two players, give the board back to the pool, forget the positions
+ * of the game and then close the dynamic librairies
  * 
  * @param board The game board
  */
 void close_server(struct graph_t* board) {
 	P1_finalize();
 	P2_finalize();
-	graph_free(board);
+	graph_pool_release(board);
+	memset(history_counts, 0, history_capacity * sizeof(*history_counts));
+	history_size = 0;
 	dlclose(P1_lib);
 	dlclose(P2_lib);
 }
 
+/**
+ * @brief Reset the state of the server before a new game
+ */
+void reset_server(void) {
+	game_over = false;
+	position_player_1 = -1;
+	position_player_2 = -1;
+	active_player = -1;
+	winner = -1;
+	turn = 0;
+}
 /**
  * @brief Do a game
  * 
  * @details Compute a game by doing the following steps :
- * - Parse the command line arguments
  * - Load the players' librairies
- * - Initialize the board
+ * - Initialize the board, reusing the board of the previous game
  * - Do the game loop
- * - Finalize the game by freeing the allocated memory
+ * - Finalize the game by closing the librairies
  * 
- * @param argc Number of command line arguments
- * @param argv An array of strings containing the command line arguments
+ * @param m The size of the board
  * 
- * @returns The exit code of the game
+ * @returns The color of the winner
  */
-int play_game(int argc, char* argv[]) {
-
-	// Parse arguments
-	parse_args(argc, argv);
-
-	// Initialize random generator
-	time_t seed = time(NULL);
-	srand(seed);
-	printf("Seed: %ld\n", seed);
+enum color_t play_one_game(size_t m) {
+	reset_server();
 
 	// Load players
 	load_libs();
 	printf("Libs loaded\n");
 
 	// Initialize a new board of size m and shape t
-	size_t m = board_size;
-	struct graph_t* board = graph_init(m, SQUARE);
-	struct graph_t* boardCopy1 = graph_init(m, SQUARE);
-	struct graph_t* boardCopy2 = graph_init(m, SQUARE);
+	struct graph_t* board = graph_pool_acquire(m);
+	board_snapshot = (struct graph_snapshot_t){ .graph = board, .version = 0 };
 	printf("Board created\n");
 
 	int edges = 2 * board_size * (board_size - 1);
@@ -450,9 +462,26 @@ int play_game(int argc, char* argv[]) {
 	// Initialize random starting player
 	active_player = rand() % 2;
 
-	// Initialize players
-	P1_initialize(BLACK, boardCopy1, num_walls);
-	P2_initialize(WHITE, boardCopy2, num_walls);
+	// Initialize the hash of the starting position
+	walls_left[BLACK] = num_walls;
+	walls_left[WHITE] = num_walls;
+	size_t positions[2] = { position_player_1, position_player_2 };
+	position_key = position_hash(board, positions, walls_left, active_player);
+	record_position(position_key);
+
+	// Initialize players, with the shared board or with their own copy
+	if (shared_board && P1_initialize_shared != NULL) {
+		P1_initialize_shared(BLACK, &board_snapshot, num_walls);
+	}
+	else {
+		P1_initialize(BLACK, graph_clone(board), num_walls);
+	}
+	if (shared_board && P2_initialize_shared != NULL) {
+		P2_initialize_shared(WHITE, &board_snapshot, num_walls);
+	}
+	else {
+		P2_initialize(WHITE, graph_clone(board), num_walls);
+	}
 	printf("Players initialized\n");
 	printf("\n");
 	printf("%s vs %s\n", P1_name(), P2_name());
@@ -490,14 +519,73 @@ int play_game(int argc, char* argv[]) {
 			break;
 		}
 
+		// Check if the game is drawn
+		if (record_position(position_key) >= 3) {
+			printf("Threefold repetition\n");
+			end_game(DRAW);
+			break;
+		}
+		if (max_turns > 0 && turn >= (size_t) max_turns) {
+			printf("Turn limit reached\n");
+			end_game(DRAW);
+			break;
+		}
+
 		active_player = get_next_player(active_player);
 	}
 
 	printf("GAME OVER\n");
-	printf("%s won\n", winner == BLACK ? P1_name() : P2_name());
+	if (winner == NO_COLOR) {
+		printf("Draw\n");
+	}
+	else {
+		printf("%s won\n", winner == BLACK ? P1_name() : P2_name());
+	}
 	printf("Finish after %zu turns\n", turn);
 
 	close_server(board);
 
+	return winner;
+}
+
+/**
+ * @brief Do the games
+ * 
+ * @details Parse the command line arguments, then play the games in a row.
+ * The board of the server and the bitboard are allocated by the first game and reused by the next ones.
+ * The copies given to the players are allocated for each game, and freed by the players when finalized
+ * 
+ * @param argc Number of command line arguments
+ * @param argv An array of strings containing the command line arguments
+ * 
+ * @returns The exit code of the games
+ */
+int play_game(int argc, char* argv[]) {
+
+	// Parse arguments
+	parse_args(argc, argv);
+
+	// Initialize random generator
+	time_t seed = time(NULL);
+	srand(seed);
+	printf("Seed: %ld\n", seed);
+
+	size_t wins[3] = { 0, 0, 0 };
+	for (int game = 0; game < num_games; ++game) {
+		wins[play_one_game(board_size)]++;
+	}
+
+	if (num_games > 1) {
+		printf("\n%s: %zu wins, %s: %zu wins, %zu draws\n", player_1_path, wins[BLACK], player_2_path, wins[WHITE], wins[NO_COLOR]);
+	}
+
+	graph_pool_clear();
+	free(history_keys);
+	free(history_counts);
+	if (board_bits != NULL) {
+		bitboard_free(board_bits);
+		board_bits = NULL;
+	}
+
 	return EXIT_SUCCESS;
 }
@@ -0,0 +1,111 @@
+/**
+ * @file bitboard_bench.c
+ *
+ * @brief Micro-benchmark comparing the bitboard distance with dijkstra()
+ *
+ * @details Usage: `./build/bitboard_bench [SIZE] [WALLS] [ITERATIONS]` \n
+ * Random valid walls are placed on the board, then the distance to the arrival line
+ * is computed from random positions with each implementation
+ */
+
+#define _POSIX_C_SOURCE 199309L
+
+#include "bitboard.h"
+#include "board.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/**
+ * @brief Get a monotonic time in nanoseconds
+ */
+static double now(void) {
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+/**
+ * @brief Place up to `count` random walls that leave a path to both arrival lines
+ *
+ * @return The number of walls placed
+ */
+static size_t place_random_walls(struct graph_t* graph, size_t count) {
+	size_t m = graph->width;
+	size_t placed = 0;
+
+	for (size_t tries = 0; placed < count && tries < 100 * count; tries++) {
+		size_t a = (rand() % (m - 1)) * m + rand() % (m - 1);
+		struct edge_t e[2];
+
+		if (rand() % 2) {
+			e[0] = (struct edge_t){ a, a + m };
+			e[1] = (struct edge_t){ a + 1, a + 1 + m };
+			if (edge_state(graph, a, a + 1) == VERTICAL_WALL_HEAD)
+				continue;
+		}
+		else {
+			e[0] = (struct edge_t){ a, a + 1 };
+			e[1] = (struct edge_t){ a + m, a + m + 1 };
+			if (edge_state(graph, a, a + m) == HORIZONTAL_WALL_HEAD)
+				continue;
+		}
+		if (!is_linked(graph, e[0].fr, e[0].to) || !is_linked(graph, e[1].fr, e[1].to))
+			continue;
+
+		place_wall(graph, e);
+		if (dijkstra(graph, no_vertex(), BLACK) == IMPOSSIBLE_DISTANCE || dijkstra(graph, no_vertex(), WHITE) == IMPOSSIBLE_DISTANCE)
+			remove_wall(graph, e);
+		else
+			placed++;
+	}
+	return placed;
+}
+
+int main(int argc, char* argv[]) {
+	size_t m = argc > 1 ? (size_t)atoi(argv[1]) : 15;
+	size_t walls = argc > 2 ? (size_t)atoi(argv[2]) : 2 * m;
+	size_t iterations = argc > 3 ? (size_t)atoi(argv[3]) : 20000;
+
+	srand(42);
+	struct graph_t* graph = graph_init(m, SQUARE);
+	walls = place_random_walls(graph, walls);
+
+	struct bitboard_t* bb = bitboard_alloc(m);
+	bitboard_load(bb, graph);
+
+	size_t* positions = malloc(iterations * sizeof(*positions));
+	for (size_t i = 0; i < iterations; i++)
+		positions[i] = rand() % graph->num_vertices;
+
+	printf("board %zux%zu, %zu walls, %zu searches per color\n", m, m, walls, iterations);
+
+	size_t reference = 0;
+	double start = now();
+	for (size_t i = 0; i < iterations; i++)
+		reference += dijkstra(graph, positions[i], BLACK) + dijkstra(graph, positions[i], WHITE);
+	double reference_time = (now() - start) / (2 * iterations);
+	printf("%-10s %10.1f ns/search\n", "dijkstra", reference_time);
+
+	const char* names[] = { "auto", "scalar", "sse2", "avx2" };
+	for (enum bitboard_impl_t impl = BITBOARD_SCALAR; impl <= BITBOARD_AVX2; impl++) {
+		if (!bitboard_select(impl)) {
+			printf("%-10s not supported\n", names[impl]);
+			continue;
+		}
+
+		size_t total = 0;
+		start = now();
+		for (size_t i = 0; i < iterations; i++)
+			total += bitboard_distance(bb, positions[i], BLACK) + bitboard_distance(bb, positions[i], WHITE);
+		double time = (now() - start) / (2 * iterations);
+
+		printf("%-10s %10.1f ns/search  x%.1f%s\n", names[impl], time, reference_time / time,
+			total == reference ? "" : "  MISMATCH");
+	}
+
+	free(positions);
+	bitboard_free(bb);
+	graph_free(graph);
+	return EXIT_SUCCESS;
+}
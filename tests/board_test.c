@@ -0,0 +1,672 @@
+/**
+ * @file board_test.c
+ *
+ * @brief Contains the tests on board.c
+ */
+
+
+
+#include "tests.h"
+#include "bitboard.h"
+#include "board.h"
+#include "move.h"
+#include "opt.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static size_t m = 6;
+static struct graph_t* graph = NULL;
+
+static void setup(void) {
+	m = 6;
+	graph = graph_init(m, SQUARE);
+}
+
+static void teardown(void) {
+	graph_free(graph);
+}
+
+void test_empty_board(void) {
+	printf("%s", __func__);
+
+	for (size_t v = 0; v < graph->num_vertices; v++) {
+		if (is_linked(graph, v, v + 1) != (v % m != m - 1)) {
+			FAIL("Horizontal neighbours should be linked, except across the border");
+			return;
+		}
+		if (v + m < graph->num_vertices && !is_linked(graph, v, v + m)) {
+			FAIL("Vertical neighbours should be linked");
+			return;
+		}
+		if (is_linked(graph, v, v + 2) || is_linked(graph, v, v)) {
+			FAIL("Non adjacent vertices should not be linked");
+			return;
+		}
+	}
+
+	for (size_t v = 0; v < graph->num_vertices; v++) {
+		if (is_owned(graph, BLACK, v) != (v < m) || is_owned(graph, WHITE, v) != (v >= graph->num_vertices - m)) {
+			FAIL("Each player should own its starting line");
+			return;
+		}
+	}
+}
+
+void test_place_remove_wall(void) {
+	printf("%s", __func__);
+
+	// Vertical wall between columns 2 and 3 on rows 1 and 2
+	struct edge_t vertical[2] = { {15, 14}, {8, 9} };
+	place_wall(graph, vertical);
+	if (is_linked(graph, 8, 9) || is_linked(graph, 9, 8) || is_linked(graph, 14, 15) || is_linked(graph, 15, 14))
+		FAIL("A vertical wall should cut its two edges in both directions");
+	if (edge_state(graph, 8, 9) != VERTICAL_WALL_HEAD || edge_state(graph, 15, 14) != VERTICAL_WALL_TAIL)
+		FAIL("A vertical wall should report its head and tail halves");
+	if (vertex_from_direction(graph, 8, EAST) != no_vertex() || vertex_from_direction(graph, 8, SOUTH) != 14)
+		FAIL("A vertical wall should only close the east direction");
+
+	// Horizontal wall crossing the vertical one
+	struct edge_t horizontal[2] = { {8, 14}, {9, 15} };
+	place_wall(graph, horizontal);
+	if (is_linked(graph, 8, 14) || is_linked(graph, 15, 9))
+		FAIL("An horizontal wall should cut its two edges in both directions");
+	if (edge_state(graph, 14, 8) != HORIZONTAL_WALL_HEAD || edge_state(graph, 9, 15) != HORIZONTAL_WALL_TAIL)
+		FAIL("An horizontal wall should report its head and tail halves");
+
+	remove_wall(graph, vertical);
+	if (!is_linked(graph, 8, 9) || !is_linked(graph, 15, 14))
+		FAIL("Removing a wall should restore its edges");
+	if (is_linked(graph, 8, 14))
+		FAIL("Removing a wall should not affect the other walls");
+
+	remove_wall(graph, horizontal);
+	size_t linked[MAX_DIRECTION];
+	if (get_linked(graph, 8, linked) != 4 || get_linked(graph, 0, linked) != 2)
+		FAIL("Removing every wall should restore the empty board");
+}
+
+void test_get_linked_many(void) {
+	printf("%s", __func__);
+
+	struct edge_t wall[2] = { {8, 14}, {9, 15} };
+	place_wall(graph, wall);
+
+	size_t linked[graph->num_vertices][MAX_DIRECTION];
+	size_t total = get_linked_many(graph, NULL, graph->num_vertices, linked);
+
+	size_t expected_total = 0;
+	for (size_t v = 0; v < graph->num_vertices; v++) {
+		size_t expected[MAX_DIRECTION];
+		expected_total += get_linked(graph, v, expected);
+		for (enum direction_t d = NO_DIRECTION; d < MAX_DIRECTION; d++) {
+			if (linked[v][d] != expected[d] || (d != NO_DIRECTION && linked[v][d] != vertex_from_direction(graph, v, d))) {
+				FAIL("get_linked_many should match get_linked and vertex_from_direction");
+				return;
+			}
+		}
+	}
+	if (total != expected_total || total != 2 * 2 * m * (m - 1) - 4)
+		FAIL("get_linked_many should count every open edge in both directions");
+
+	size_t subset[2] = { 14, 0 };
+	if (get_linked_many(graph, subset, 2, linked) != 5 || linked[0][NORTH] != no_vertex() || linked[1][EAST] != 1)
+		FAIL("get_linked_many should process the given vertices in order");
+
+	remove_wall(graph, wall);
+}
+
+void test_distance_field(void) {
+	printf("%s", __func__);
+
+	size_t field[graph->num_vertices];
+	distance_field(graph, BLACK, field);
+	for (size_t v = 0; v < graph->num_vertices; v++) {
+		if (field[v] != m - 1 - v / m || dijkstra(graph, v, BLACK) != field[v]) {
+			FAIL("On an empty board, the distance should be the number of rows to cross");
+			return;
+		}
+	}
+	if (dijkstra(graph, no_vertex(), WHITE) != m)
+		FAIL("A player not on the board yet should count its first move");
+
+	// Close row 3 from column 0 to 3, and force a detour through column 4 or 5
+	struct edge_t w1[2] = { {18, 24}, {19, 25} };
+	struct edge_t w2[2] = { {20, 26}, {21, 27} };
+	place_wall(graph, w1);
+	place_wall(graph, w2);
+	distance_field(graph, BLACK, field);
+	if (field[18] != 4 + 2 || field[22] != 2 || dijkstra(graph, 18, BLACK) != field[18])
+		FAIL("The distance should go around the walls");
+
+	// Close the row completely
+	struct edge_t w3[2] = { {22, 28}, {23, 29} };
+	place_wall(graph, w3);
+	distance_field(graph, WHITE, field);
+	if (field[35] != IMPOSSIBLE_DISTANCE || field[18] != 3 || dijkstra(graph, 35, WHITE) != IMPOSSIBLE_DISTANCE)
+		FAIL("Unreachable vertices should have an impossible distance");
+
+	remove_wall(graph, w1);
+	remove_wall(graph, w2);
+	remove_wall(graph, w3);
+}
+
+void test_bitboard_distance(void) {
+	printf("%s", __func__);
+
+	struct edge_t w1[2] = { {18, 24}, {19, 25} };
+	struct edge_t w2[2] = { {20, 26}, {21, 27} };
+	struct edge_t w3[2] = { {16, 17}, {22, 23} };
+	place_wall(graph, w1);
+	place_wall(graph, w2);
+	place_wall(graph, w3);
+
+	struct bitboard_t* bb = bitboard_alloc(m);
+	bitboard_load(bb, graph);
+
+	for (enum bitboard_impl_t impl = BITBOARD_SCALAR; impl <= BITBOARD_AVX2; impl++) {
+		if (!bitboard_select(impl))
+			continue;
+		for (size_t v = 0; v < graph->num_vertices; v++) {
+			if (bitboard_distance(bb, v, BLACK) != dijkstra(graph, v, BLACK) || bitboard_distance(bb, v, WHITE) != dijkstra(graph, v, WHITE)) {
+				FAIL("The bitboard distance should match the graph distance");
+				break;
+			}
+		}
+		if (bitboard_distance(bb, no_vertex(), BLACK) != dijkstra(graph, no_vertex(), BLACK))
+			FAIL("The bitboard distance should start from the starting line when the player is not on the board");
+	}
+	bitboard_select(BITBOARD_AUTO);
+
+	// Close the last gap of the row
+	struct edge_t w4[2] = { {22, 28}, {23, 29} };
+	bitboard_close_wall(bb, w4);
+	if (bitboard_can_reach(bb, 0, BLACK) || bitboard_can_reach(bb, 35, WHITE) || !bitboard_can_reach(bb, 30, BLACK))
+		FAIL("A closed row should separate the players from their arrival line");
+
+	// Opening the wall again gives back the planes of the board
+	bitboard_open_wall(bb, w4);
+	struct bitboard_t* loaded = bitboard_alloc(m);
+	bitboard_load(loaded, graph);
+	for (enum direction_t d = NORTH; d <= EAST; d++)
+		if (memcmp(bb->open[d], loaded->open[d], bb->words * sizeof(*bb->open[d])) != 0)
+			FAIL("An opened wall should restore the edges it closed");
+	bitboard_free(loaded);
+
+	bitboard_free(bb);
+	remove_wall(graph, w1);
+	remove_wall(graph, w2);
+	remove_wall(graph, w3);
+}
+
+/**
+ * @brief Check the maintained distance fields against a full computation
+ */
+static bool fields_are_exact(struct graph_t* g) {
+	size_t field[g->num_vertices];
+	for (enum color_t color = BLACK; color <= WHITE; color++) {
+		distance_field(g, color, field);
+		for (size_t v = 0; v < g->num_vertices; v++)
+			if (get_distance_field(g, color)[v] != field[v])
+				return false;
+	}
+	return true;
+}
+
+void test_incremental_distance_fields(void) {
+	printf("%s", __func__);
+
+	struct graph_t* g = graph_init(9, SQUARE);
+	enable_distance_fields(g);
+	size_t w = g->width;
+
+	struct edge_t walls[40][2];
+	size_t num_walls = 0;
+	for (size_t tries = 0; tries < 2000 && num_walls < 40; tries++) {
+		size_t a = (rand() % (w - 1)) * w + rand() % (w - 1);
+		struct edge_t* e = walls[num_walls];
+		if (rand() % 2) {
+			e[0] = (struct edge_t){ a, a + w };
+			e[1] = (struct edge_t){ a + 1, a + 1 + w };
+		}
+		else {
+			e[0] = (struct edge_t){ a, a + 1 };
+			e[1] = (struct edge_t){ a + w, a + w + 1 };
+		}
+		if (!is_linked(g, e[0].fr, e[0].to) || !is_linked(g, e[1].fr, e[1].to))
+			continue;
+
+		place_wall(g, e);
+		if (!fields_are_exact(g)) {
+			FAIL("Placing a wall should repair the distance fields");
+			break;
+		}
+
+		// Try and undo a wall, as a search would do
+		if (rand() % 3 == 0) {
+			remove_wall(g, e);
+			if (!fields_are_exact(g)) {
+				FAIL("Removing the last wall should restore the distance fields");
+				break;
+			}
+			continue;
+		}
+		num_walls++;
+	}
+
+	// Remove the walls out of order
+	for (size_t i = 0; i < num_walls; i += 2)
+		remove_wall(g, walls[i]);
+	if (!fields_are_exact(g))
+		FAIL("Removing walls in any order should keep the distance fields exact");
+	for (size_t i = 1; i < num_walls; i += 2)
+		remove_wall(g, walls[i]);
+	if (!fields_are_exact(g) || goal_distance(g, 0, BLACK) != w - 1)
+		FAIL("Removing every wall should restore the empty board distances");
+
+	graph_free(g);
+}
+
+void test_wall_may_disconnect(void) {
+	printf("%s", __func__);
+
+	struct edge_t free_wall[2] = { {14, 20}, {15, 21} };
+	if (wall_may_disconnect(graph, free_wall))
+		FAIL("A wall far from the border and from the other walls should not disconnect");
+
+	// Wall touching the west border, then a wall extending it
+	struct edge_t w1[2] = { {18, 24}, {19, 25} };
+	struct edge_t w2[2] = { {20, 26}, {21, 27} };
+	if (wall_may_disconnect(graph, w1))
+		FAIL("A wall touching the border once should not disconnect");
+	place_wall(graph, w1);
+	if (wall_may_disconnect(graph, w2))
+		FAIL("A wall extending a chain touching the border once should not disconnect");
+	place_wall(graph, w2);
+
+	// Closing the row reaches the east border
+	struct edge_t w3[2] = { {22, 28}, {23, 29} };
+	if (!wall_may_disconnect(graph, w3))
+		FAIL("A wall linking two walls connected to the border should be checked");
+
+	// A wall going down from the chain to the south border closes a loop too
+	struct edge_t w4[2] = { {33, 32}, {27, 26} };
+	if (!wall_may_disconnect(graph, w4))
+		FAIL("A wall between a chain and the border should be checked");
+
+	// Rolling back restores the sets
+	remove_wall(graph, w2);
+	if (wall_may_disconnect(graph, w2) || wall_may_disconnect(graph, w3))
+		FAIL("Removing the last wall should roll back the sets");
+
+	// Out of order removal
+	place_wall(graph, w2);
+	remove_wall(graph, w1);
+	if (wall_may_disconnect(graph, w1) || wall_may_disconnect(graph, w3))
+		FAIL("Removing any wall should rebuild the sets");
+	remove_wall(graph, w2);
+}
+
+/**
+ * @brief Check that every wall rejected by wall_may_disconnect() keeps both arrival lines reachable
+ */
+void test_wall_may_disconnect_random(void) {
+	printf("%s", __func__);
+
+	struct graph_t* g = graph_init(9, SQUARE);
+	size_t w = g->width;
+
+	struct edge_t walls[40][2];
+	size_t num_walls = 0;
+	for (size_t tries = 0; tries < 4000 && num_walls < 40; tries++) {
+		size_t a = (rand() % (w - 1)) * w + rand() % (w - 1);
+		struct edge_t* e = walls[num_walls];
+		if (rand() % 2) {
+			e[0] = (struct edge_t){ a, a + w };
+			e[1] = (struct edge_t){ a + 1, a + 1 + w };
+		}
+		else {
+			e[0] = (struct edge_t){ a, a + 1 };
+			e[1] = (struct edge_t){ a + w, a + w + 1 };
+		}
+		if (!is_linked(g, e[0].fr, e[0].to) || !is_linked(g, e[1].fr, e[1].to))
+			continue;
+
+		// Count the vertices that can reach each line, a wall that does not close a loop can not change them
+		size_t before[2], after[2];
+		size_t field[g->num_vertices];
+		for (enum color_t color = BLACK; color <= WHITE; color++) {
+			distance_field(g, color, field);
+			before[color] = 0;
+			for (size_t v = 0; v < g->num_vertices; v++)
+				before[color] += field[v] != IMPOSSIBLE_DISTANCE;
+		}
+		bool may_disconnect = wall_may_disconnect(g, e);
+		place_wall(g, e);
+		for (enum color_t color = BLACK; color <= WHITE; color++) {
+			distance_field(g, color, field);
+			after[color] = 0;
+			for (size_t v = 0; v < g->num_vertices; v++)
+				after[color] += field[v] != IMPOSSIBLE_DISTANCE;
+		}
+		if (!may_disconnect && (before[BLACK] != after[BLACK] || before[WHITE] != after[WHITE])) {
+			FAIL("A wall that disconnects vertices should be detected");
+			break;
+		}
+
+		if (rand() % 3 == 0 || after[BLACK] != g->num_vertices || after[WHITE] != g->num_vertices)
+			remove_wall(g, e);
+		else
+			num_walls++;
+	}
+
+	graph_free(g);
+}
+
+/**
+ * @brief Check the free wall emplacements against the edges of the graph
+ */
+static bool wall_slots_are_exact(struct graph_t* g) {
+	size_t w = g->width;
+	size_t count = 0;
+	for (size_t head = 0; head < g->num_vertices; head++) {
+		for (enum orientation_t o = HORIZONTAL; o <= VERTICAL; o++) {
+			bool expected = false;
+			if (head / w < w - 1 && head % w < w - 1) {
+				struct edge_t e[2];
+				wall_edges(w, head * 2 + o, e);
+				unsigned crossing = edge_state(g, head, o == HORIZONTAL ? head + 1 : head + w);
+				expected = is_linked(g, e[0].fr, e[0].to) && is_linked(g, e[1].fr, e[1].to)
+					&& crossing != (o == HORIZONTAL ? VERTICAL_WALL_HEAD : HORIZONTAL_WALL_HEAD);
+			}
+			if (((g->wall_slots->free[o][head / 64] >> (head % 64)) & 1) != expected)
+				return false;
+			count += expected;
+		}
+	}
+	return count == wall_slots_count(g->wall_slots);
+}
+
+void test_wall_slots(void) {
+	printf("%s", __func__);
+
+	if (wall_slots_count(graph->wall_slots) != 2 * (m - 1) * (m - 1))
+		FAIL("Every emplacement should be free on an empty board");
+
+	struct edge_t horizontal[2] = { {8, 14}, {9, 15} };
+	place_wall(graph, horizontal);
+	if (wall_slots_count(graph->wall_slots) != 2 * (m - 1) * (m - 1) - 4 || !wall_slots_are_exact(graph))
+		FAIL("A wall should block itself, the wall crossing it and the two walls overlapping it");
+
+	struct edge_t e[2];
+	wall_edges(m, 8 * 2 + VERTICAL, e);
+	if (e[0].fr != 8 || e[0].to != 9 || e[1].fr != 14 || e[1].to != 15)
+		FAIL("A vertical wall should cut the east edges of its head and of the vertex below");
+	remove_wall(graph, horizontal);
+
+	struct graph_t* g = graph_init(9, SQUARE);
+	size_t w = g->width;
+	struct edge_t walls[30][2];
+	size_t num_walls = 0;
+	for (size_t tries = 0; tries < 2000 && num_walls < 30; tries++) {
+		// Pick a free emplacement at random
+		size_t count = wall_slots_count(g->wall_slots);
+		size_t k = rand() % count;
+		for (size_t wall = 0; wall < 2 * g->num_vertices; wall++) {
+			if (((g->wall_slots->free[wall % 2][wall / 2 / 64] >> (wall / 2 % 64)) & 1) && k-- == 0) {
+				wall_edges(w, wall, walls[num_walls]);
+				break;
+			}
+		}
+		place_wall(g, walls[num_walls]);
+		if (rand() % 3 == 0)
+			remove_wall(g, walls[num_walls]);
+		else
+			num_walls++;
+		if (!wall_slots_are_exact(g)) {
+			FAIL("The free emplacements should follow the placed and removed walls");
+			break;
+		}
+	}
+	for (size_t i = 0; i < num_walls; i += 2)
+		remove_wall(g, walls[i]);
+	if (!wall_slots_are_exact(g))
+		FAIL("Removing walls in any order should release their emplacements");
+
+	graph_free(g);
+}
+
+void test_place_wall_twice(void) {
+	printf("%s", __func__);
+
+	struct edge_t wall[2] = { {8, 14}, {9, 15} };
+	uint8_t empty_cells[m * m];
+	memcpy(empty_cells, graph->cells, m * m);
+
+	place_wall(graph, wall);
+	uint8_t cells[m * m];
+	memcpy(cells, graph->cells, m * m);
+	size_t free_slots = wall_slots_count(graph->wall_slots);
+	uint64_t hash = graph->hash;
+
+	place_wall(graph, wall);
+	if (memcmp(cells, graph->cells, m * m) != 0 || wall_slots_count(graph->wall_slots) != free_slots
+		|| graph->hash != hash || !wall_slots_are_exact(graph))
+		FAIL("Placing a wall already placed should leave the graph as it is");
+
+	remove_wall(graph, wall);
+	if (memcmp(empty_cells, graph->cells, m * m) != 0 || wall_slots_count(graph->wall_slots) != 2 * (m - 1) * (m - 1)
+		|| graph->hash != 0 || !wall_slots_are_exact(graph))
+		FAIL("Removing a wall placed twice should give back the empty board");
+}
+
+/**
+ * @brief Check a pawn move with the linked vertices, as the rules are written
+ */
+static bool is_pawn_move_reference(struct graph_t* g, size_t pos, size_t opponent, size_t destination) {
+	if (destination == opponent)
+		return false;
+	if (is_linked(g, pos, destination))
+		return true;
+	if (!is_linked(g, pos, opponent))
+		return false;
+	// Straight or diagonal jump over the opponent, but never back to the pawn
+	return destination != pos && is_linked(g, opponent, destination);
+}
+
+void test_pawn_moves(void) {
+	printf("%s", __func__);
+
+	// Opponent on the north, with the straight jump closed by a wall
+	struct edge_t wall[2] = { {8, 14}, {9, 15} };
+	place_wall(graph, wall);
+	uint16_t moves = pawn_moves(graph, 20, 14);
+	if (moves != (1 << STEP_SOUTH | 1 << STEP_WEST | 1 << STEP_EAST | 1 << JUMP_NORTH_WEST | 1 << JUMP_NORTH_EAST))
+		FAIL("A pawn should jump beside an opponent blocked by a wall");
+	remove_wall(graph, wall);
+	if (!((pawn_moves(graph, 20, 14) >> JUMP_NORTH) & 1) || pawn_move_offset(m, JUMP_NORTH) != -2 * (long)m)
+		FAIL("A pawn should jump straight over an opponent");
+	if (pawn_moves(graph, 0, no_vertex()) != (1 << STEP_SOUTH | 1 << STEP_EAST))
+		FAIL("A pawn in a corner should only step inside the board");
+
+	struct graph_t* g = graph_init(7, SQUARE);
+	size_t w = g->width;
+	for (size_t tries = 0; tries < 500; tries++) {
+		if (wall_slots_count(g->wall_slots) > 0 && rand() % 4 == 0) {
+			size_t k = rand() % wall_slots_count(g->wall_slots);
+			for (size_t id = 0; id < 2 * g->num_vertices; id++) {
+				if (((g->wall_slots->free[id % 2][id / 2 / 64] >> (id / 2 % 64)) & 1) && k-- == 0) {
+					struct edge_t e[2];
+					wall_edges(w, id, e);
+					place_wall(g, e);
+					break;
+				}
+			}
+		}
+
+		size_t pos = rand() % g->num_vertices;
+		size_t opponent = rand() % 2 ? rand() % g->num_vertices : pos + (rand() % 2 ? 1 : w);
+		if (opponent == pos || opponent >= g->num_vertices)
+			continue;
+
+		size_t destinations[MAX_PAWN_MOVE];
+		size_t num = get_pawn_moves(g, pos, opponent, destinations);
+		size_t expected = 0;
+		for (size_t v = 0; v < g->num_vertices; v++) {
+			bool legal = is_pawn_move_reference(g, pos, opponent, v);
+			expected += legal;
+			if (is_pawn_move(g, pos, opponent, v) != legal) {
+				FAIL("The pawn moves should follow the rules");
+				tries = 500;
+				break;
+			}
+		}
+		if (num != expected)
+			FAIL("get_pawn_moves should count every legal destination once");
+	}
+	graph_free(g);
+}
+
+void test_graph_reset_and_pool(void) {
+	printf("%s", __func__);
+
+	struct graph_t* g = graph_pool_acquire(9);
+	enable_distance_fields(g);
+	struct edge_t w1[2] = { {36, 45}, {37, 46} };
+	struct edge_t w2[2] = { {38, 47}, {39, 48} };
+	place_wall(g, w1);
+	place_wall(g, w2);
+
+	struct graph_t* clone = graph_clone(g);
+	if (is_linked(clone, 36, 45) || !is_linked(clone, 40, 49) || wall_slots_count(clone->wall_slots) != wall_slots_count(g->wall_slots))
+		FAIL("A clone should have the same walls");
+	graph_free(clone);
+
+	graph_pool_release(g);
+	struct graph_t* reused = graph_pool_acquire(9);
+	if (reused != g)
+		FAIL("A released graph should be reused");
+	if (!is_linked(reused, 36, 45) || wall_slots_count(reused->wall_slots) != 2 * 8 * 8 || !fields_are_exact(reused))
+		FAIL("A reused graph should be empty");
+
+	// w1 would link the border to w2 if the wall sets were not reset
+	if (wall_may_disconnect(reused, w1))
+		FAIL("A reused graph should forget the walls of the previous game");
+
+	graph_pool_release(reused);
+	graph_pool_clear();
+}
+
+void test_position_hash(void) {
+	printf("%s", __func__);
+
+	size_t pos[2] = { 2, 33 };
+	size_t num_walls[2] = { 3, 3 };
+	uint64_t start = position_hash(graph, pos, num_walls, BLACK);
+	if (start == position_hash(graph, pos, num_walls, WHITE))
+		FAIL("The player to move should change the hash");
+
+	struct edge_t wall[2] = { {8, 14}, {9, 15} };
+	place_wall(graph, wall);
+	uint64_t with_wall = position_hash(graph, pos, num_walls, BLACK);
+	if (with_wall == start || (with_wall ^ start) != zobrist_key(ZOBRIST_WALL, 8 * 2 + HORIZONTAL))
+		FAIL("Placing a wall should xor its key into the hash");
+
+	struct graph_t* clone = graph_clone(graph);
+	if (clone->hash != graph->hash)
+		FAIL("A clone should have the same hash");
+	graph_free(clone);
+
+	remove_wall(graph, wall);
+	if (position_hash(graph, pos, num_walls, BLACK) != start || graph->hash != 0)
+		FAIL("Removing a wall should restore the hash");
+
+	size_t moved[2] = { 8, 33 };
+	if ((position_hash(graph, moved, num_walls, BLACK) ^ start) != (zobrist_pawn(BLACK, 2) ^ zobrist_pawn(BLACK, 8)))
+		FAIL("Moving a pawn should xor its two keys into the hash");
+}
+
+void test_wall_candidates(void) {
+	printf("%s", __func__);
+
+	struct graph_t* g = graph_init(9, SQUARE);
+	size_t w = g->width;
+	size_t ids[2 * g->num_vertices];
+
+	bool exact = true;
+	for (size_t round = 0; round < 30 && exact; round++) {
+		graph_reset(g);
+		for (size_t tries = 0; tries < 40; tries++) {
+			size_t wall = ((rand() % (w - 1)) * w + rand() % (w - 1)) * 2 + rand() % 2;
+			struct edge_t e[2];
+			wall_edges(w, wall, e);
+			if (!((g->wall_slots->free[wall % 2][wall / 2 / 64] >> (wall / 2 % 64)) & 1))
+				continue;
+			place_wall(g, e);
+			if (dijkstra(g, no_vertex(), BLACK) == IMPOSSIBLE_DISTANCE || dijkstra(g, no_vertex(), WHITE) == IMPOSSIBLE_DISTANCE)
+				remove_wall(g, e);
+		}
+
+		// The first rounds keep a player out of the board
+		size_t pos[2];
+		pos[BLACK] = round < 5 ? no_vertex() : (size_t)rand() % g->num_vertices;
+		pos[WHITE] = (size_t)rand() % g->num_vertices;
+
+		uint8_t marks[g->num_vertices];
+		memset(marks, 0, sizeof(marks));
+		for (enum color_t color = BLACK; color <= WHITE; color++)
+			mark_shortest_paths(g, pos[color], color, marks);
+
+		size_t count = wall_candidates(g, marks, 0, ids);
+		size_t with_others = wall_candidates(g, marks, 3, ids + count);
+		if (with_others < count || with_others > count + 3) {
+			FAIL("At most the requested number of other walls should be added");
+			break;
+		}
+
+		// A wall that is not a candidate can not change the distance of a player
+		size_t before[2] = { dijkstra(g, pos[BLACK], BLACK), dijkstra(g, pos[WHITE], WHITE) };
+		size_t next = 0;
+		for (size_t wall = 0; wall < 2 * g->num_vertices; wall++) {
+			if (!((g->wall_slots->free[wall % 2][wall / 2 / 64] >> (wall / 2 % 64)) & 1))
+				continue;
+			if (next < count && ids[next] == wall) {
+				next++;
+				continue;
+			}
+
+			struct edge_t e[2];
+			wall_edges(w, wall, e);
+			place_wall(g, e);
+			exact = exact && dijkstra(g, pos[BLACK], BLACK) == before[BLACK] && dijkstra(g, pos[WHITE], WHITE) == before[WHITE];
+			remove_wall(g, e);
+		}
+		if (!exact)
+			FAIL("A wall changing a distance should be a candidate");
+		if (next != count) {
+			FAIL("The candidates should be free walls sorted by identifier");
+			break;
+		}
+	}
+
+	graph_free(g);
+}
+
+void test_board_main(void) {
+	TEST(test_empty_board);
+	TEST(test_place_remove_wall);
+	TEST(test_get_linked_many);
+	TEST(test_distance_field);
+	TEST(test_bitboard_distance);
+	TEST(test_incremental_distance_fields);
+	TEST(test_wall_may_disconnect);
+	TEST(test_wall_may_disconnect_random);
+	TEST(test_wall_slots);
+	TEST(test_place_wall_twice);
+	TEST(test_pawn_moves);
+	TEST(test_graph_reset_and_pool);
+	TEST(test_position_hash);
+	TEST(test_wall_candidates);
+
+	SUMMARY();
+}
@@ -10,6 +10,7 @@
 #include "move.h"
 
 char* name = "Dummy";
+bool board_read_only = true;
 
 struct move_t make_first_move(struct game_state_t game) {
 	return make_default_first_move(game);
@@ -0,0 +1,458 @@
+/**
+ * @file geralt_test.c
+ *
+ * @brief Contains the tests on the moves of Geralt (geralt_board.c), its goal fields (geralt_fields.c)
+ * and its pawn races (geralt_race.c)
+ */
+
+
+
+#include "tests.h"
+#include "board.h"
+#include "graph.h"
+#include "geralt.h"
+#include "move.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ROUND_TRIP_MOVES 300
+#define RACE_POSITIONS 60
+#define RACE_DEPTH 9
+#define FIELD_PLIES 40
+
+static size_t m = 9;
+static struct graph_t* graph = NULL;
+static SimpleGameState state;
+static int start_pos[2] = { 0, 0 };
+static uint16_t* fields[2] = { NULL, NULL };
+
+/**
+ * @brief Build the compact state of the graph, with both pawns on the board and BLACK to move
+ */
+static void load_state(size_t width) {
+	m = width;
+	graph = graph_init(m, SQUARE);
+
+	state = (SimpleGameState) {
+		.cells = malloc(graph->num_vertices),
+		.slots = wall_slots_alloc(m),
+		.width = (int)m,
+		.color = BLACK,
+		.pos = (int)(m / 2),
+		.num_walls = ROUND_TRIP_MOVES,
+		.opponent_pos = (int)(graph->num_vertices - 1 - m / 2),
+		.opponent_num_walls = ROUND_TRIP_MOVES,
+		.start_pos = &start_pos[0],
+		.opponent_start_pos = &start_pos[1],
+		.target_is_up = false
+	};
+	memcpy(state.cells, graph->cells, graph->num_vertices);
+	wall_slots_copy(state.slots, graph->wall_slots);
+}
+
+static void free_state(void) {
+	free(state.cells);
+	wall_slots_free(state.slots);
+	graph_free(graph);
+	graph = NULL;
+}
+
+static void setup(void) {
+	graph = NULL;
+}
+
+static void teardown(void) {
+	if (graph != NULL)
+		free_state();
+	free(fields[BLACK]);
+	free(fields[WHITE]);
+	fields[BLACK] = fields[WHITE] = NULL;
+}
+
+/**
+ * @brief Hash of the graph with the pawns and the walls of the state, as seen by the player to move
+ */
+static uint64_t reference_hash(void) {
+	size_t pos[2];
+	size_t walls[2];
+	pos[state.color] = state.pos == -1 ? no_vertex() : (size_t)state.pos;
+	pos[1 - state.color] = state.opponent_pos == -1 ? no_vertex() : (size_t)state.opponent_pos;
+	walls[state.color] = (size_t)state.num_walls;
+	walls[1 - state.color] = (size_t)state.opponent_num_walls;
+	return position_hash(graph, pos, walls, state.color);
+}
+
+/**
+ * @brief Check that the state holds the walls of the graph
+ */
+static bool same_board(void) {
+	if (memcmp(state.cells, graph->cells, graph->num_vertices) != 0)
+		return false;
+	for (int o = 0; o < 2; o++)
+		if (memcmp(state.slots->free[o], graph->wall_slots->free[o], state.slots->words * sizeof(uint64_t)) != 0)
+			return false;
+	return state.hash == reference_hash();
+}
+
+/**
+ * @brief Get the edges of a packed wall
+ */
+static void move_edges(unsigned move, struct edge_t e[2]) {
+	wall_edges(m, (size_t)MOVE_VALUE(move) * 2 + !MOVE_HORIZONTAL(move), e);
+}
+
+/**
+ * @brief Fill the goal fields of both colors from the graph
+ */
+static void load_fields(void) {
+	size_t* d = malloc(graph->num_vertices * sizeof(size_t));
+	for (int color = BLACK; color <= WHITE; color++) {
+		fields[color] = realloc(fields[color], graph->num_vertices * sizeof(uint16_t));
+		distance_field(graph, color, d);
+		for (size_t v = 0; v < graph->num_vertices; v++)
+			fields[color][v] = d[v] == IMPOSSIBLE_DISTANCE ? UNREACHABLE : (uint16_t)d[v];
+	}
+	free(d);
+}
+
+/**
+ * @brief Check the goal fields of both colors at a ply against the fields computed on the graph
+ */
+static bool same_fields(GoalFields* goal_fields, int ply) {
+	load_fields();
+	for (int color = BLACK; color <= WHITE; color++)
+		if (memcmp(goal_field(goal_fields, &state, ply, color), fields[color], graph->num_vertices * sizeof(uint16_t)) != 0)
+			return false;
+	return true;
+}
+
+/**
+ * @brief Put the pawns on the board with no walls left, the player to move going to its target line
+ */
+static void set_race(enum color_t to_move, int pos, int opponent_pos) {
+	state.color = to_move;
+	state.target_is_up = to_move == WHITE;
+	state.pos = pos;
+	state.opponent_pos = opponent_pos;
+	state.num_walls = state.opponent_num_walls = 0;
+	state.hash = reference_hash();
+}
+
+/**
+ * @brief Minimax of the pawn moves on depth plies, without the shortcuts of solve_race()
+ */
+static enum race_result_t race_minimax(int depth, int* plies) {
+	if (fields[1 - state.color][state.opponent_pos] == 0) {
+		*plies = 0;
+		return RACE_LOSS;
+	}
+	if (depth == 0)
+		return RACE_UNKNOWN;
+
+	unsigned moves[MAX_PAWN_MOVE];
+	int nb_of_moves = 0;
+	add_displacement_moves(&state, moves, &nb_of_moves);
+
+	int win_plies = INT32_MAX;
+	int loss_plies = 0;
+	bool unknown = nb_of_moves == 0;
+	for (int i = 0; i < nb_of_moves; i++) {
+		int child_plies;
+		apply_move(&state, moves[i]);
+		enum race_result_t child = race_minimax(depth - 1, &child_plies);
+		undo_move(&state, moves[i]);
+
+		if (child == RACE_LOSS && child_plies + 1 < win_plies)
+			win_plies = child_plies + 1;
+		else if (child == RACE_WIN && child_plies + 1 > loss_plies)
+			loss_plies = child_plies + 1;
+		else if (child == RACE_UNKNOWN)
+			unknown = true;
+	}
+
+	if (win_plies != INT32_MAX) {
+		*plies = win_plies;
+		return RACE_WIN;
+	}
+	if (unknown)
+		return RACE_UNKNOWN;
+	*plies = loss_plies;
+	return RACE_LOSS;
+}
+
+void test_move_encoding(void) {
+	printf("%s", __func__);
+
+	size_t n2 = GERALT_MAX_WIDTH * GERALT_MAX_WIDTH;
+	for (size_t corner = 0; corner < n2; corner++) {
+		for (int horizontal = 0; horizontal <= 1; horizontal++) {
+			unsigned move = WALL_MOVE(corner, horizontal);
+			if (move == 0 || MOVE_TYPE(move) != WALL || MOVE_VALUE(move) != (int)corner || MOVE_HORIZONTAL(move) != horizontal) {
+				FAIL("A wall should be decoded as it was encoded");
+				return;
+			}
+		}
+	}
+
+	// the offsets go up to a move from outside the board to the last vertex
+	for (int inc = -(int)n2; inc <= (int)n2; inc++) {
+		unsigned move = DISPLACEMENT_MOVE(inc);
+		if (move == 0 || MOVE_TYPE(move) != MOVE || MOVE_VALUE(move) != inc) {
+			FAIL("A displacement should be decoded as it was encoded");
+			return;
+		}
+	}
+}
+
+void test_apply_undo_round_trip(void) {
+	printf("%s", __func__);
+
+	const size_t widths[] = { 5, 9, 17, 31, GERALT_MAX_WIDTH };
+	srand(22);
+
+	for (size_t k = 0; k < sizeof(widths) / sizeof(widths[0]); k++) {
+		load_state(widths[k]);
+		state.hash = reference_hash();
+
+		uint8_t* cells = malloc(graph->num_vertices);
+		memcpy(cells, state.cells, graph->num_vertices);
+		SimpleGameState initial = state;
+		unsigned moves[ROUND_TRIP_MOVES];
+
+		// random walls on free slots and random jumps of the pawns, the moves do not need to be legal
+		for (int i = 0; i < ROUND_TRIP_MOVES; i++) {
+			unsigned move;
+			if (rand() % 2 && wall_slots_count(state.slots) > 0) {
+				size_t wall;
+				do
+					wall = (size_t)rand() % (2 * graph->num_vertices);
+				while (!(state.slots->free[wall % 2][wall / 2 / 64] >> (wall / 2 % 64) & 1));
+				move = WALL_MOVE(wall / 2, wall % 2 == HORIZONTAL);
+
+				struct edge_t e[2];
+				move_edges(move, e);
+				place_wall(graph, e);
+			}
+			else {
+				int destination = rand() % (int)graph->num_vertices;
+				move = DISPLACEMENT_MOVE(destination - state.pos);
+			}
+
+			apply_move(&state, move);
+			moves[i] = move;
+			if (!same_board()) {
+				FAIL("apply_move() should update the cells, the wall slots and the hash as the board does");
+				free(cells);
+				return;
+			}
+		}
+
+		for (int i = ROUND_TRIP_MOVES - 1; i >= 0; i--) {
+			undo_move(&state, moves[i]);
+			if (MOVE_TYPE(moves[i]) == WALL) {
+				struct edge_t e[2];
+				move_edges(moves[i], e);
+				remove_wall(graph, e);
+			}
+			if (!same_board()) {
+				FAIL("undo_move() should restore the cells, the wall slots and the hash");
+				free(cells);
+				return;
+			}
+		}
+
+		if (memcmp(cells, state.cells, graph->num_vertices) != 0 || state.hash != initial.hash || state.color != initial.color
+			|| state.pos != initial.pos || state.opponent_pos != initial.opponent_pos || state.num_walls != initial.num_walls
+			|| state.opponent_num_walls != initial.opponent_num_walls || state.target_is_up != initial.target_is_up) {
+			FAIL("Undoing every move should give back the initial state");
+		}
+
+		free(cells);
+		free_state();
+	}
+}
+
+void test_race_face_to_face(void) {
+	printf("%s", __func__);
+
+	load_state(5);
+	load_fields();
+	RaceTable table;
+	race_table_init(&table, 10);
+
+	// BLACK, 3 vertices from its line, jumps over WHITE, 2 vertices from its own, and arrives first
+	int plies;
+	set_race(BLACK, 7, 12);
+	if (solve_race(&table, &state, (const uint16_t**)fields, &plies) != RACE_WIN || plies != 3)
+		FAIL("The player to move should win a face to face race by jumping over the opponent");
+
+	// with a wall behind WHITE, BLACK has to step beside it and arrives too late
+	struct edge_t e[2];
+	wall_edges(m, 12 * 2 + HORIZONTAL, e);
+	place_wall(graph, e);
+	memcpy(state.cells, graph->cells, graph->num_vertices);
+	load_fields();
+	set_race(BLACK, 7, 12);
+	if (solve_race(&table, &state, (const uint16_t**)fields, &plies) != RACE_LOSS || plies != 4)
+		FAIL("The player to move should lose a face to face race when it can only step beside the opponent");
+
+	race_table_free(&table);
+}
+
+void test_race_solver(void) {
+	printf("%s", __func__);
+
+	srand(24);
+	load_state(5);
+	RaceTable table;
+	race_table_init(&table, 12);
+
+	for (int k = 0; k < RACE_POSITIONS; k++) {
+		// a few walls on an empty board, a race is only solved if both pawns can reach their line
+		graph_reset(graph);
+		for (int w = 0; w < k % 6; w++) {
+			size_t wall = (size_t)rand() % (2 * graph->num_vertices);
+			if (graph->wall_slots->free[wall % 2][wall / 2 / 64] >> (wall / 2 % 64) & 1) {
+				struct edge_t e[2];
+				wall_edges(m, wall, e);
+				place_wall(graph, e);
+			}
+		}
+		memcpy(state.cells, graph->cells, graph->num_vertices);
+		load_fields();
+
+		enum color_t to_move = rand() % 2;
+		int pos = rand() % (int)graph->num_vertices;
+		int opponent_pos = rand() % (int)graph->num_vertices;
+		if (pos == opponent_pos || fields[to_move][pos] == 0 || fields[to_move][pos] == UNREACHABLE
+			|| fields[1 - to_move][opponent_pos] == 0 || fields[1 - to_move][opponent_pos] == UNREACHABLE) {
+			k--;
+			continue;
+		}
+		set_race(to_move, pos, opponent_pos);
+
+		int expected_plies = 0;
+		int plies = 0;
+		enum race_result_t expected = race_minimax(RACE_DEPTH, &expected_plies);
+		enum race_result_t result = solve_race(&table, &state, (const uint16_t**)fields, &plies);
+		if (expected != RACE_UNKNOWN && (result != expected || plies != expected_plies)) {
+			FAIL("A race ending within the depth of the minimax should be solved with the same result and length");
+			break;
+		}
+		if (expected == RACE_UNKNOWN && result != RACE_UNKNOWN && plies <= RACE_DEPTH) {
+			FAIL("A race solved by solve_race() should not end before the depth of the minimax");
+			break;
+		}
+	}
+
+	race_table_free(&table);
+}
+
+/**
+ * @brief Pick a free wall emplacement at random
+ */
+static unsigned random_wall(void) {
+	size_t wall;
+	do
+		wall = (size_t)rand() % (2 * graph->num_vertices);
+	while (!(state.slots->free[wall % 2][wall / 2 / 64] >> (wall / 2 % 64) & 1));
+	return WALL_MOVE(wall / 2, wall % 2 == HORIZONTAL);
+}
+
+/**
+ * @brief Play a move on the state and on the graph, or take it back
+ */
+static void play_on_both(unsigned move, bool take_back) {
+	if (take_back)
+		undo_move(&state, move);
+	if (MOVE_TYPE(move) == WALL) {
+		struct edge_t e[2];
+		move_edges(move, e);
+		if (take_back)
+			remove_wall(graph, e);
+		else
+			place_wall(graph, e);
+	}
+	if (!take_back)
+		apply_move(&state, move);
+}
+
+void test_goal_fields(void) {
+	printf("%s", __func__);
+
+	srand(23);
+	load_state(9);
+	state.hash = reference_hash();
+	GoalFields goal_fields = {
+		.buffers = malloc(FIELD_PLIES * 2 * graph->num_vertices * sizeof(uint16_t)),
+		.queue = malloc(graph->num_vertices * sizeof(int))
+	};
+	reset_goal_fields(&goal_fields);
+
+	unsigned moves[FIELD_PLIES];
+	int kept = 0;
+	int changed = 0;
+	int plies = 0;
+	for (int ply = 0; ply < FIELD_PLIES - 1 && pass; ply++) {
+		// the fields of some plies are never asked for, a wall then can't be checked against them
+		if (ply % 4 != 3 && !same_fields(&goal_fields, ply)) {
+			FAIL("The fields of a ply should be the distances of its position");
+			break;
+		}
+
+		unsigned move;
+		if (ply % 3 == 2) {
+			int nb_of_moves = 0;
+			unsigned pawn_moves[MAX_PAWN_MOVE];
+			add_displacement_moves(&state, pawn_moves, &nb_of_moves);
+			move = pawn_moves[rand() % nb_of_moves];
+		}
+		else {
+			// a first wall fills the fields of the next ply, which the second one must not reuse if it changes them
+			unsigned sibling = random_wall();
+			play_on_both(sibling, false);
+			update_goal_fields(&goal_fields, &state, ply, sibling);
+			if (!same_fields(&goal_fields, ply + 1))
+				FAIL("The fields after a wall should be the distances of the new position");
+			play_on_both(sibling, true);
+			move = random_wall();
+		}
+
+		play_on_both(move, false);
+		update_goal_fields(&goal_fields, &state, ply, move);
+		moves[ply] = move;
+		plies++;
+		if (MOVE_TYPE(move) == WALL) {
+			for (int color = BLACK; color <= WHITE; color++) {
+				if (goal_fields.owner[ply + 1][color] == goal_fields.owner[ply][color])
+					kept++;
+				else
+					changed++;
+			}
+		}
+	}
+
+	// the fields of a ply are still the ones of its position once the deeper plies are undone
+	for (int ply = plies - 1; ply >= 0; ply--) {
+		play_on_both(moves[ply], true);
+		if (pass && !same_fields(&goal_fields, ply))
+			FAIL("Undoing a move should give back the fields of the previous ply");
+	}
+
+	if (kept == 0 || changed == 0)
+		FAIL("The walls should include walls keeping the fields and walls changing them");
+
+	free(goal_fields.buffers);
+	free(goal_fields.queue);
+}
+
+void test_geralt_main(void) {
+	TEST(test_move_encoding);
+	TEST(test_apply_undo_round_trip);
+	TEST(test_goal_fields);
+	TEST(test_race_face_to_face);
+	TEST(test_race_solver);
+
+	SUMMARY();
+}
@@ -56,6 +56,64 @@ void test_get_player_name(void) {
 	}
 }
 
+extern bool board_read_only;
+void update_graph(struct move_t move);
+
+void test_initialize_shared(void) {
+	printf("%s", __func__);
+
+	// Replace the player initialized by setup
+	finalize();
+	struct graph_t *server_board = graph_init(n, SQUARE);
+	struct graph_snapshot_t snapshot = { server_board, 0 };
+	struct edge_t wall[2] = { {0, 3}, {1, 4} };
+	struct move_t move = { .m = 0, .e = { wall[0], wall[1] }, .t = WALL, .c = BLACK };
+
+	// A strategy which only reads the board plays on a view of the board of the server
+	board_read_only = true;
+	initialize_shared(WHITE, &snapshot, 2);
+	if (game.graph == server_board || game.graph->cells != server_board->cells
+		|| game.graph->scratch == server_board->scratch || game.self.color != WHITE) {
+		FAIL("A read-only strategy should read the shared board with its own search buffers");
+	}
+
+	place_wall(server_board, wall);
+	snapshot.version++;
+	size_t free_slots = wall_slots_count(server_board->wall_slots);
+	update_graph(move);
+	if (game.opponent.num_walls != 1 || wall_slots_count(server_board->wall_slots) != free_slots) {
+		FAIL("A wall of the shared board should be counted without being placed again");
+	}
+	if (game.graph->hash != server_board->hash || is_linked(game.graph, 0, 3)) {
+		FAIL("The view should be synchronized with the shared board");
+	}
+	finalize();
+
+	// Any other strategy gets a clone, into which the walls are replayed
+	board_read_only = false;
+	initialize_shared(WHITE, &snapshot, 2);
+	if (game.graph == server_board || !is_linked(game.graph, 2, 5) || is_linked(game.graph, 0, 3)) {
+		FAIL("A strategy modifying the board should get a clone of the shared board");
+	}
+
+	struct edge_t other_wall[2] = { {4, 7}, {5, 8} };
+	place_wall(server_board, other_wall);
+	snapshot.version++;
+	move.e[0] = other_wall[0];
+	move.e[1] = other_wall[1];
+	update_graph(move);
+	if (is_linked(game.graph, 4, 7) || is_linked(game.graph, 5, 8)) {
+		FAIL("The walls should be replayed into the clone");
+	}
+	finalize();
+	board_read_only = true;
+
+	graph_free(server_board);
+
+	// Restore a player for the teardown
+	initialize(BLACK, graph_init(n, SQUARE), 2);
+}
+
 void test_play_random(void) {
 	printf("%s", __func__);
 }
@@ -63,6 +121,7 @@ void test_play_random(void) {
 void test_player_main(void) {
 	TEST(test_initialization);
 	TEST(test_get_player_name);
+	TEST(test_initialize_shared);
 	// TEST(test_play_random);
 
 	SUMMARY();
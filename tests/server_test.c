@@ -18,13 +18,14 @@
 #include <stdlib.h>
 #include <unistd.h>
 
-enum reasons_t { WIN = 0, INVALID_MOVE = 1 };
+enum reasons_t { WIN = 0, INVALID_MOVE = 1, DRAW = 2 };
 bool is_valid_displacement(struct graph_t* board, size_t destination, enum color_t player);
 bool is_valid_wall(struct graph_t* board, struct edge_t e[]);
 void update_board(struct graph_t* board, struct move_t* last_move);
 int is_winning(struct graph_t* board, enum color_t active_player, size_t position);
 bool move_is_valid(struct move_t* mv, struct graph_t* board, enum color_t player);
 void end_game(enum reasons_t reason);
+size_t record_position(uint64_t key);
 
 
 struct game_state_t game_s;
@@ -39,9 +40,10 @@ extern size_t position_player_1;
 extern size_t position_player_2;
 extern enum color_t active_player;
 extern bool game_over;
+extern uint64_t position_key;
 
-void* P1_lib;
-void* P2_lib;
+extern void* P1_lib;
+extern void* P2_lib;
 extern char* (*P1_name)(void);
 extern char* (*P2_name)(void);
 
@@ -390,11 +392,49 @@ void test_move_is_valid() {
 	(void)garbage;
 }
 
+void test_position_history(void) {
+	printf("%s", __func__);
+
+	position_player_1 = 0;
+	position_player_2 = 35;
+	active_player = BLACK;
+	uint64_t start = position_key;
+
+	// Both players go forth and back
+	struct move_t moves[4] = {
+		{ .m = 6, .t = MOVE, .c = BLACK },
+		{ .m = 29, .t = MOVE, .c = WHITE },
+		{ .m = 0, .t = MOVE, .c = BLACK },
+		{ .m = 35, .t = MOVE, .c = WHITE }
+	};
+	for (int i = 0; i < 4; ++i) {
+		update_board(my_board, &moves[i]);
+		active_player = 1 - active_player;
+		if (i < 3 && position_key == start) {
+			FAIL("Different positions should have different keys");
+		}
+	}
+	if (position_key != start) {
+		FAIL("Coming back to a position should give the same key");
+	}
+
+	if (record_position(start) != 1 || record_position(start ^ 1) != 1 || record_position(start) != 2 || record_position(start) != 3) {
+		FAIL("The history should count the occurrences of each position");
+	}
+	for (uint64_t key = 0; key < 1000; ++key) {
+		record_position(key * 0x9E3779B97F4A7C15ULL);
+	}
+	if (record_position(start) != 4) {
+		FAIL("The history should keep the positions while growing");
+	}
+}
+
 void test_server_main(void) {
 	TEST(test_is_winning);
 	TEST(test_is_valid_displacement);
 	TEST(test_is_valid_wall);
 	TEST(test_move_is_valid);
 	TEST(test_update_board);
+	TEST(test_position_history);
 	SUMMARY();
 }
@@ -8,5 +8,7 @@ int main() {
 
 	test_player_main();
 	test_server_main();
+	test_board_main();
+	test_geralt_main();
 	return EXIT_SUCCESS;
 }
@@ -15,5 +15,7 @@ static int total = 0;
 
 void test_player_main(void);
 void test_server_main(void);
+void test_board_main(void);
+void test_geralt_main(void);
 
 #endif // _QUOR_TESTS_H_